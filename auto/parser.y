@@ -29,7 +29,7 @@
     NIdentifier* ident;
     NVarDeclaration* var_decl;
     NVarBlock* vars_block;
-    NType* type;
+    const NType* type;
     NCode* code;
     NStruct* nstruct;
     NRoot* root;
@@ -38,6 +38,7 @@
 	NPolymElem* polym_elem;
     NParent* parent_class;
     NAlias* alias;
+    NAnnotation* annotation;
 
     TypeSuffixList* type_suffixes;
     ArraySuffixList* array_suff;
@@ -46,6 +47,8 @@
     BodyList* body_list;
     ParentsList* parents_list;
 	PolymList* polym_list;
+    AnnotationArgs* annotation_args;
+    AnnotationList* annotation_list;
 
     std::string* string;
     bool boolean;
@@ -62,12 +65,13 @@
 %token <token> T_POLYM "polymorphic" T_VIRTUAL "virtual" T_USING "using" T_ALIAS "alias"
 %token <token> T_COMMA "," T_DOT "." T_SEMIC ";" T_AT "@" T_EQ "=" T_STAR "*" T_COLONS ":" 
 %token <token> T_L_BRACE "{" T_R_BRACE "}" T_L_ACUTE "<" T_R_ACUTE ">" T_OPEN_SQ "[" T_CLOSE_SQ "]"
+%token <token> T_L_PAREN "(" T_R_PAREN ")"
 
 /* Define the type of node our nonterminal symbols represent.
    The types refer to the %union declaration above.  */
 %type <token> type_suffix
 %type <type_suffixes> type_suffixes type_suff_0
-%type <type> decl_type compl_type
+%type <type> decl_type compl_type generic_arg
 %type <ident> ident
 %type <vars_block> vars_block
 %type <var_decl> var_decl
@@ -86,6 +90,10 @@
 %type <vars_list> var_decls
 %type <parents_list> parents_list parents_list_c
 %type <polym_list> polym_list
+%type <string> annotation_arg
+%type <annotation> annotation
+%type <annotation_args> annotation_args
+%type <annotation_list> annotations_0
 
 %start program
 
@@ -135,20 +143,25 @@ array_suff_0 : %empty { $$ = new ArraySuffixList(); }
              | array_suff { $$ = $1; }
              ;
 
-generics_content : compl_type { $$ = new GenericsList(); $$->push_back($1); }
-                 | generics_content "," compl_type { $1->push_back($3); }
+/* a generic argument can also be a value, as in std::array<int, 5> */
+generic_arg : compl_type { $$ = $1; }
+            | T_CODE { $$ = NType::get(_P(@$), std::move(*$1)); delete $1; }
+            ;
+
+generics_content : generic_arg { $$ = new GenericsList(); $$->push_back($1); }
+                 | generics_content "," generic_arg { $1->push_back($3); }
                  ;
 
 /* a complete type, it may include '*' and '[]' */
-compl_type : ident "<" generics_content ">" { $$ = new NType(_P(@$), $1, $3); }
-           | ident { $$ = new NType(_P(@$), $1, new GenericsList()); }
+compl_type : ident "<" generics_content ">" { $$ = NType::get(_P(@$), $1, $3); }
+           | ident { $$ = NType::get(_P(@$), $1, new GenericsList()); }
            | compl_type "*" { $$ = NType::pointerTo($1, _P(@$)); }
            | compl_type "[" T_CODE "]" { $$ = NType::arrayOf($1, $3, _P(@$)); }
            ;
 
 /* type for declarations: '*' and '[]' are bound to the variable name */
-decl_type : ident "<" generics_content ">" { $$ = new NType(_P(@$), $1, $3); }
-          | ident { $$ = new NType(_P(@$), $1, new GenericsList()); }
+decl_type : ident "<" generics_content ">" { $$ = NType::get(_P(@$), $1, $3); }
+          | ident { $$ = NType::get(_P(@$), $1, new GenericsList()); }
           ;
 
 ident : T_IDENTIFIER { $$ = new NIdentifier(_P(@$), std::move(*$1)); delete $1; }
@@ -161,8 +174,25 @@ var_decls : var_decl { $$ = new VarDeclList(); $$->push_back($<var_decl>1); }
           | var_decls T_COMMA var_decl { $1->push_back($<var_decl>3); }
           ;
 
-var_decl : type_suff_0 ident array_suff_0 { $$ = new NVarDeclaration(_P(@$), $1, $2, $3, nullptr); }
-         | type_suff_0 ident array_suff_0 "=" code_block { $$ = new NVarDeclaration(_P(@$), $1, $2, $3, $5); }
+/* annotations change how a field is serialized, as in: `float* data @length(n);` */
+annotation_arg : ident { $$ = new std::string($1->value); delete $1; }
+               | T_CODE { $$ = $1; }
+               ;
+
+annotation_args : annotation_arg { $$ = new AnnotationArgs(); $$->push_back($1); }
+                | annotation_args "," annotation_arg { $1->push_back($3); }
+                ;
+
+annotation : "@" ident { $$ = new NAnnotation(_P(@$), $2, new AnnotationArgs()); }
+           | "@" ident "(" annotation_args ")" { $$ = new NAnnotation(_P(@$), $2, $4); }
+           ;
+
+annotations_0 : %empty { $$ = new AnnotationList(); }
+              | annotations_0 annotation { $1->push_back($2); }
+              ;
+
+var_decl : type_suff_0 ident array_suff_0 annotations_0 { $$ = new NVarDeclaration(_P(@$), $1, $2, $3, $4, nullptr); }
+         | type_suff_0 ident array_suff_0 annotations_0 "=" code_block { $$ = new NVarDeclaration(_P(@$), $1, $2, $3, $4, $6); }
          ;
 
 cls_or_struct : T_CLASS { $$ = true; }
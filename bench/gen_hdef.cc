@@ -0,0 +1,27 @@
+// writes a large input for the generator benchmark: gen_hdef <output> [structs]
+#include <fstream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char** argv) {
+	if (argc < 2) return 1;
+	ofstream out(argv[1]);
+	const int n = argc > 2 ? stoi(argv[2]) : 2000;
+	out << "`#include <string>`\n`#include <vector>`\n`#include <map>`\n`#include <memory>`\n\n";
+	for (int i = 0; i < n; i++) {
+		// chains of aliases, resolved by every field that uses them
+		out << "using id" << i << " = " << (i ? "id" + to_string(i - 1) : "int") << ";\n";
+		out << "struct bench" << i << " {\n"
+			<< "\tid" << i << " a, b, c;\n"
+			<< "\tstd::string name;\n"
+			<< "\tstd::vector<std::map<std::string, std::vector<id" << i << ">>> nested;\n"
+			<< "\tdouble m[4][4];\n"
+			<< "\tint* p, *q;\n"
+			<< "\tfloat* data @length(a);\n"
+			<< "\tuint8_t flags @bits(3);\n";
+		if (i) out << "\tstd::unique_ptr<bench" << i - 1 << "> prev;\n";
+		out << "};\n\n";
+	}
+	return out.good() ? 0 : 1;
+}
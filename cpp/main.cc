@@ -2,11 +2,14 @@
 #include <parser.hh>
 #include <types.hh>
 #include <polym.hh>
+#include <runtime.hh>
 
 #include <iostream>
 #include <unordered_map>
+#include <unordered_set>
 #include <fstream>
 #include <typeinfo>
+#include <algorithm>
 
 extern FILE* yyin;
 extern int yyparse();
@@ -32,7 +35,7 @@ void compileRoot(NAlias* alias) {
 	string name_s = to_string(*alias->name);
 	add_alias(alias->pos, name_s, alias->real);
 	if (alias->in_code) { // `using` is reflected on the header, `alias` is not
-		hout << "using " << name_s << " = " << to_cpp_type(*alias->real) << ";" << endl;
+		hout << "using " << name_s << " = " << to_cpp_type(*alias->real) << ";" << '\n';
 	}
 }
 
@@ -43,43 +46,325 @@ void compileCode(string* value) {
 
 void compileRoot(NCode* code_node) {
 	compileCode(code_node->code);
-	hout << endl;
+	hout << '\n';
 }
 
-// compile into the real header and into the serialization function
+// field annotations understood by the serializer
+const unordered_set<string> known_annotations = { "length", "columnar", "lazy", "bits", "range", "dict", "sparse" };
+
+void checkAnnotations(const NVarDeclaration& dec) {
+	for (const NAnnotation* a : *dec.annotations)
+		if (known_annotations.find(a->name->value) == known_annotations.end())
+			throw runtime_error("at " + to_string(a->pos) + ": unknown annotation @" + a->name->value);
+	if (const NAnnotation* sparse = dec.findAnnotation("sparse"))
+		if (!dec.assignment || !sparse->args->empty() || !is_comparable_type(dec.completeType))
+			throw runtime_error("at " + to_string(sparse->pos) + ": @sparse expects a field with an initializer, "
+				"of a type that can be compared (native values, strings and std containers of them)");
+}
+
+// compile into the real header
 void compileBlock(NStruct* st, NVarBlock* block) {
-	hout << "\t" << to_cpp_type(*block->type);
 	VarDeclList& list = *block->vars;
+	bool open = false; // a declaration of the block type is not terminated yet
 	for (int i = 0; i < list.size(); i++) {
 		NVarDeclaration& dec = *list[i];
 		string& fname = dec.name->value;
-		// insert in the header
+		// insert in the header, lazy pointers have their own type
+		const bool lazy = dec.findAnnotation("lazy");
+		if (open && !lazy) hout << ",";
+		else {
+			if (open) hout << ";" << '\n';
+			hout << "\t" << to_cpp_type(lazy ? *dec.completeType : *block->type);
+			open = !lazy;
+		}
 		hout << " ";
-		for (int j = 0; j < dec.tSuffixes->size(); j++)
+		for (int j = 0; j < dec.tSuffixes->size() && !lazy; j++)
 			hout << "*"; // can't be anything else
 		hout << fname;
 		for (string* size : *dec.arraySuffixes)
 			hout << "[" << *size << "]";
 		if (dec.assignment)
 			hout << " = " << *dec.assignment;
-		if (i != list.size() - 1) hout << ",";
-		else hout << ";" << endl;
-		// insert in the data
-		serialize_field(fname, *dec.completeType, dout);
+		if (lazy) hout << ";" << '\n';
+		else if (i == list.size() - 1) hout << ";" << '\n';
+		checkAnnotations(dec);
 	}
 }
 
+/* the fields in the order they are written: consecutive scalar `@bits` and `@range` fields
+ * (e.g. flags) are packed together, and written as a single field. `@sparse` ones are written alone */
+vector<output_field> output_fields(NStruct* st) {
+	vector<output_field> res;
+	bool packing = false;
+	for (NBodyElem* elem : *st->body)
+		IF_TYPE(elem, NVarBlock, block)
+			for (const NVarDeclaration* dec : *block->vars) {
+				const bool packed = is_packed_scalar(*dec->completeType) && !dec->findAnnotation("sparse");
+				if (!packed || !packing) res.push_back({ {}, packed });
+				res.back().decls.push_back(dec);
+				packing = packed;
+			}
+	return res;
+}
+
+// `@sparse` fields are written only when they differ from their initializer
+bool is_sparse(const output_field& f) {
+	return f.decls[0]->findAnnotation("sparse");
+}
+
+/* declares the flags `__w_<field>` of the `@sparse` fields which differ from the ones of a default object,
+ * and returns the expression counting the written fields */
+string compileSparseFlags(NStruct* st, const vector<output_field>& fields) {
+	string count = to_string(fields.size());
+	bool defaults = false;
+	for (const output_field& f : fields) {
+		if (!is_sparse(f)) continue;
+		if (!defaults)
+			dout << "\tstatic const " << *st->name << " __d;" << '\n';
+		defaults = true;
+		const string n = f.name();
+		dout << "\tconst bool __w_" << n << " = !(" << n << " == __d." << n << ");" << '\n';
+		count += " - !__w_" + n;
+	}
+	return count;
+}
+
+// the name of the struct, and the number of written fields
+void compilePreface(NStruct* st, const vector<output_field>& fields) {
+	const string count = compileSparseFlags(st, fields);
+	if (count == to_string(fields.size()))
+		dout << "\t__s << \"" << *st->name << " " << count << "\" << \"\\n\";" << '\n';
+	else
+		dout << "\t__s << \"" << *st->name << " \" << (" << count << ") << \"\\n\";" << '\n';
+}
+
+void compileWriteField(const output_field& f) {
+	if (is_sparse(f)) dout << "\tif (__w_" << f.name() << ") {" << '\n';
+	serialize_field(f, dout);
+	if (is_sparse(f)) dout << "\t}" << '\n';
+}
+
+/* the id of the layout of a struct whose fields are all native values (or static arrays of them),
+ * whose objects can be written as a single block of raw memory; empty for other structs */
+string raw_layout(NStruct* st, const vector<output_field>& fields) {
+	if (st->isVirtual || !st->parents->empty() || getPolymOf(st->name) || fields.empty()) return "";
+	uint64_t h = 14695981039346656037ull; // FNV-1a of the names and types of the fields
+	for (const output_field& f : fields) {
+		const NType* t = f.decls[0]->completeType;
+		if (f.packed || !is_raw_type(t)) return "";
+		for (char c : f.name() + " " + to_cpp_type(*t) + ";")
+			h = (h ^ (unsigned char) c) * 1099511628211ull;
+	}
+	string res;
+	for (int i = 60; i >= 0; i -= 4) res += "0123456789abcdef"[(h >> i) & 15];
+	return res;
+}
+
+// without padding, objects of structs with a raw layout are written as a single field, `#raw`
+void compileRawWrite(NStruct* st, const string& layout, const string& ret) {
+	dout << "\tif constexpr (_is_raw()) {" << '\n'
+		<< "\t\t__s << \"" << *st->name << " 1\\n#raw " << layout << "/\" << sizeof(" << *st->name << ") << ' ';" << '\n'
+		<< "\t\t__s.write((const char*) this, sizeof(" << *st->name << "));" << '\n'
+		<< "\t\t__s << \"\\n\";" << '\n'
+		<< "\t\t" << ret << ";" << '\n'
+		<< "\t}" << '\n';
+}
+
 // compile into deserialization function
-void compileDsBlock(NStruct* st, NVarBlock* block) {
-	VarDeclList& list = *block->vars;
-	for (NVarDeclaration* decl_ptr : list) {
-		NVarDeclaration& dec = *decl_ptr;
-		string& fname = dec.name->value;
-		dout << "\t\t{\"" << fname << "\", [&, __e](" << *st->name << "& __v) -> bool {" << endl;
-		deserialize_field(fname, *dec.completeType, dout);
-		dout << "\t\t\treturn 1;" << endl // got to the end -> success
-			<< "\t\t} }," << endl;
+void compileDsField(NStruct* st, const output_field& f) {
+	// captureless, as the map is shared by every call
+	dout << "\t\t{\"" << f.name() << "\", [](" << *st->name << "& __v, __DS_ARGS) -> bool {" << '\n';
+	deserialize_field(f, dout);
+	dout << "\t\t\treturn 1;" << '\n' // got to the end -> success
+		<< "\t\t} }," << '\n';
+}
+
+/* compile the column-wise (de)serialization of `__n` elements of this struct, used by `@columnar` vectors:
+ * a single header, then every field for all the elements at once. parents are written as columns too */
+void compileColumns(NStruct* st, size_t fields_count) {
+	const string name = to_string(*st->name);
+	const string args = "const char* __first, size_t __stride, size_t __n";
+	auto parent_first = [&](NParent* p, const string& cnst) {
+		return "(" + cnst + "char*) static_cast<" + cnst + to_string(*p->type) + "*>((" + cnst + name + "*) __first)";
+	};
+	// writer, both synchronous and coroutine-based
+	if (async_mode)
+		dout << "__as_task " << name << "::_serialize_columns_async(__as_async_buffer& __w, __as_async_state& __pm, " << args << ") {" << '\n'
+			<< "\tostream& __s = __w.stream();" << '\n';
+	else
+		dout << "void " << name << "::_serialize_columns(ostream& __s, __serialization_state& __pm, " << args << ") {" << '\n';
+	dout << "\t__s << \"" << name << " " << fields_count << "\" << \"\\n\";" << '\n';
+	for (NParent* p : *st->parents) {
+		if (async_mode)
+			dout << "\tco_await " << *p->type << "::_serialize_columns_async(__w, __pm, " << parent_first(p, "const ") << ", __stride, __n);" << '\n';
+		else
+			dout << "\t" << *p->type << "::_serialize_columns(__s, __pm, " << parent_first(p, "const ") << ", __stride, __n);" << '\n';
+	}
+	for (const output_field& f : output_fields(st))
+		serialize_column(name, f, dout);
+	if (async_mode) dout << "\tco_return;" << '\n';
+	dout << "}" << '\n' << '\n';
+	if (async_mode) return;
+	// reader
+	dout << "bool " << name << "::_deserialize_columns(istream& __s, const __as_error_callback& __e, __deserialization_state& __pm, char* __first, size_t __stride, size_t __n) {" << '\n'
+		<< "\t__TYPE_CHK(\"" << name << "\");" << '\n'
+		<< "\tsize_t __count; __s >> __count;" << '\n'
+		<< "\tif (__count != " << fields_count << ") ""if (__e( \"'" << name << "': read \" + to_string(__count) + \" fields, expected " << fields_count << "\")) return 0;" << '\n';
+	for (NParent* p : *st->parents)
+		dout << "\tif (!" << *p->type << "::_deserialize_columns(__s, __e, __pm, " << parent_first(p, "") << ", __stride, __n)) return 0;" << '\n';
+	dout << "\tstatic const unordered_map<string, bool(*)(char*, size_t, size_t, __DS_ARGS)> __map = {" << '\n';
+	for (const output_field& f : output_fields(st)) {
+		dout << "\t\t{\"" << f.name() << "\", [](char* __first, size_t __stride, size_t __n, __DS_ARGS) -> bool {" << '\n';
+		deserialize_column(name, f, dout);
+		dout << "\t\t\treturn 1;" << '\n'
+			<< "\t\t} }," << '\n';
+	}
+	dout << "\t};" << '\n'
+		<< "\tfor (size_t __i = 0; __i < __count; __i++) {" << '\n'
+		<< "\t\tstring& __fn = __pm.token; __s >> __fn;" << '\n'
+		<< "\t\tconst auto& __itr = __map.find(__fn);" << '\n'
+		<< "\t\tif (__itr == __map.end()) if(__e(\"'" << name << "': unknown field '\" + __fn + \"'\")) return 0;" << '\n'
+		<< "\t\tif (!__itr->second(__first, __stride, __n, __s, __e, __pm)) return 0;" << '\n'
+		<< "\t}" << '\n'
+		<< "\treturn 1;" << '\n'
+		<< "}" << '\n' << '\n';
+	// size
+	dout << "void " << name << "::_serialized_size_columns(__size_state& __pm, " << args << ") {" << '\n'
+		<< "\t__pm.size += " << name.size() + 1 + to_string(fields_count).size() + 1 << ";" << '\n';
+	for (NParent* p : *st->parents)
+		dout << "\t" << *p->type << "::_serialized_size_columns(__pm, " << parent_first(p, "const ") << ", __stride, __n);" << '\n';
+	for (const output_field& f : output_fields(st))
+		size_column(name, f, dout);
+	dout << "}" << '\n' << '\n';
+}
+
+// compile the size computation, which mirrors `_serialize_to` and `serialize_to`
+void compileSize(NStruct* st, size_t fields_count, const string& layout) {
+	const string preface = to_string(*st->name) + " " + to_string(fields_count);
+	dout << "void " << *st->name << "::_serialized_size(__size_state& __pm) const {" << '\n';
+	if (!layout.empty()) {
+		dout << "\tif constexpr (_is_raw()) {" << '\n'
+			<< "\t\t__pm.size += " << raw_struct_size(to_string(*st->name), layout) << ";" << '\n'
+			<< "\t\treturn;" << '\n'
+			<< "\t}" << '\n';
+	}
+	const vector<output_field> fields = output_fields(st);
+	const string count = compileSparseFlags(st, fields);
+	if (count == to_string(fields_count))
+		dout << "\t__pm.size += " << preface.size() + 1 << ";" << '\n';
+	else
+		dout << "\t__pm.size += " << to_string(*st->name).size() + 2 << " + __as_digits((size_t) (" << count << "));" << '\n';
+	for (NParent* p : *st->parents)
+		dout << "\t" << *p->type << "::_serialized_size(__pm);" << '\n';
+	for (const output_field& f : fields) {
+		if (is_sparse(f)) dout << "\tif (__w_" << f.name() << ") {" << '\n';
+		size_field(f, dout);
+		if (is_sparse(f)) dout << "\t}" << '\n';
 	}
+	dout << "}" << '\n' << '\n'
+		<< "size_t " << *st->name << "::serialized_size() const {" << '\n'
+		<< "\t__as_context __ctx;" << '\n'
+		<< "\treturn serialized_size(__ctx);" << '\n'
+		<< "}" << '\n' << '\n'
+		<< "size_t " << *st->name << "::serialized_size(__as_context& __ctx) const {" << '\n'
+		<< "\t__size_state& __pm = __ctx.size;" << '\n'
+		<< "\t__pm.clear();" << '\n'
+		<< "\t_serialized_size(__pm);" << '\n'
+		<< "\tfor (size_t __i = 0; __i < __pm.pending.size(); __i++) {" << '\n'
+		<< "\t\tconst __as_deferred_size __d = __pm.pending[__i];" << '\n'
+		<< "\t\t__pm.dict_clear();" << '\n'
+		<< "\t\t__pm.size += __as_digits(__i + 1) + 2;" << '\n'
+		<< "\t\t__d.size(__d.value, __pm);" << '\n'
+		<< "\t}" << '\n'
+		<< "\treturn __pm.size;" << '\n'
+		<< "}" << '\n' << '\n'
+		<< "size_t " << *st->name << "::serialize_to(char* __out, size_t __capacity, bool __canonical) const {" << '\n'
+		<< "\t__as_out_membuf __b(__out, __capacity);" << '\n'
+		<< "\tostream __s(&__b);" << '\n'
+		<< "\tserialize_to(__s, __canonical);" << '\n'
+		<< "\treturn __s.fail() ? 0 : __b.written();" << '\n'
+		<< "}" << '\n' << '\n';
+}
+
+// compile the heap accounting, which walks the same fields and pointers as `_serialize_to`
+void compileFootprint(NStruct* st) {
+	const string& name = to_string(*st->name);
+	const vector<output_field> fields = output_fields(st);
+	dout << "void " << name << "::_memory_heap(__footprint_state& __pm) const {" << '\n';
+	for (NParent* p : *st->parents)
+		dout << "\t" << *p->type << "::_memory_heap(__pm);" << '\n';
+	if (!fields.empty()) // only the fields of the object measured are listed
+		dout << "\tauto* const __fields = __pm.fields;" << '\n'
+			<< "\t__pm.fields = nullptr;" << '\n'
+			<< "\tsize_t __b;" << '\n';
+	for (const output_field& f : fields)
+		for (const NVarDeclaration* d : f.decls) {
+			const string& fname = d->name->value;
+			dout << "\t__b = __pm.bytes;" << '\n';
+			heap_value(fname, *d->completeType, dout);
+			dout << "\tif (__fields) {" << '\n'
+				<< "\t\t__pm.count_pending();" << '\n' // the values pointed by the field
+				<< "\t\t__fields->emplace_back(\"" << fname << "\", sizeof(" << fname << ") + __pm.bytes - __b);" << '\n'
+				<< "\t}" << '\n';
+		}
+	if (!fields.empty())
+		dout << "\t__pm.fields = __fields;" << '\n';
+	dout << "}" << '\n' << '\n'
+		<< "void " << name << "::_memory_pointee(__footprint_state& __pm) const {" << '\n'
+		<< "\t__pm.bytes += sizeof(" << name << ");" << '\n'
+		<< "\t_memory_heap(__pm);" << '\n'
+		<< "}" << '\n' << '\n'
+		<< "size_t " << name << "::memory_footprint() const {" << '\n'
+		<< "\t__footprint_state __pm;" << '\n'
+		<< "\t__pm.first(this);" << '\n'
+		<< "\t_memory_pointee(__pm);" << '\n'
+		<< "\t__pm.count_pending();" << '\n'
+		<< "\treturn __pm.bytes;" << '\n'
+		<< "}" << '\n' << '\n'
+		<< "size_t " << name << "::memory_footprint(vector<pair<string, size_t>>& __fields) const {" << '\n'
+		<< "\t__footprint_state __pm;" << '\n'
+		<< "\t__pm.fields = &__fields;" << '\n'
+		<< "\t__pm.first(this);" << '\n'
+		<< "\t_memory_pointee(__pm);" << '\n'
+		<< "\t__pm.count_pending();" << '\n'
+		<< "\treturn __pm.bytes;" << '\n'
+		<< "}" << '\n' << '\n';
+}
+
+// compile the coroutine-based serializer, which mirrors `_serialize_to` and `serialize_to`
+void compileAsync(NStruct* st, size_t fields_count, const string& layout) {
+	async_mode = true;
+	dout << "#ifdef __AS_ASYNC" << '\n'
+		<< "__as_task " << *st->name << "::_serialize_async(__as_async_buffer& __w, __as_async_state& __pm) const {" << '\n'
+		<< "\tostream& __s = __w.stream();" << '\n';
+	if (!layout.empty())
+		compileRawWrite(st, layout, "co_return");
+	const vector<output_field> fields = output_fields(st);
+	compilePreface(st, fields);
+	for (NParent* p : *st->parents)
+		dout << "\tco_await " << *p->type << "::_serialize_async(__w, __pm);" << '\n';
+	for (const output_field& f : fields) {
+		compileWriteField(f);
+		dout << "\t__AS_YIELD;" << '\n';
+	}
+	dout << "\tco_return;" << '\n'
+		<< "}" << '\n' << '\n'
+		<< "__as_task " << *st->name << "::serialize_async_to(__as_async_buffer& __w) const {" << '\n'
+		<< "\tostream& __s = __w.stream();" << '\n'
+		<< "\t__as_async_state __pm;" << '\n'
+		<< "\tco_await _serialize_async(__w, __pm);" << '\n'
+		<< "\tfor (size_t __i = 0; __i < __pm.pending.size(); __i++) {" << '\n'
+		<< "\t\tconst __as_deferred_async __write = __pm.pending[__i];" << '\n'
+		<< "\t\t__pm.dict_clear();" << '\n'
+		<< "\t\t__s << (__i + 1) << ' ';" << '\n'
+		<< "\t\tco_await __write.write(__write.value, __w, __pm);" << '\n'
+		<< "\t\t__s << \"\\n\";" << '\n'
+		<< "\t\t__AS_YIELD;" << '\n'
+		<< "\t}" << '\n'
+		<< "}" << '\n' << '\n';
+	compileColumns(st, fields_count);
+	dout << "#endif" << '\n' << '\n';
+	async_mode = false;
 }
 
 void compileRoot(NStruct* st) {
@@ -95,19 +380,22 @@ void compileRoot(NStruct* st) {
 		}
 	}
 	compileCode(st->code_parents);
-	hout << " {" << endl;
+	hout << " {" << '\n';
 	// data preface
-	dout << "#undef __AS_CTX" << endl // prevent compilation warnings
-		<< "#define __AS_CTX \"" << *st->name << "\"s" << endl << endl
-		<< "void " << *st->name << "::_serialize_to(ostream& __s, unordered_map<void*, function<void()>>& __pm) const {" << endl;
-	size_t fields_count = 0;
-	for (NBodyElem* elem : *st->body)
-		IF_TYPE(elem, NVarBlock, block)
-			fields_count += block->vars->size();
-	dout << "\t__s << \"" << *st->name << " " << fields_count << "\" << \"\\n\";" << endl;
+	dout << "#undef __AS_CTX" << '\n' // prevent compilation warnings
+		<< "#define __AS_CTX \"" << *st->name << "\"s" << '\n' << '\n'
+		<< "void " << *st->name << "::_serialize_to(ostream& __s, __serialization_state& __pm) const {" << '\n';
+	const vector<output_field> fields = output_fields(st);
+	const size_t fields_count = fields.size();
+	const string layout = raw_layout(st, fields);
+	if (!layout.empty()) {
+		add_raw_struct(to_string(*st->name), layout);
+		compileRawWrite(st, layout, "return");
+	}
+	compilePreface(st, fields);
 	// before fileds, serialize parent classes
 	for (NParent* p : *st->parents)
-		dout << "\t" << *p->type << "::_serialize_to(__s, __pm);" << endl;
+		dout << "\t" << *p->type << "::_serialize_to(__s, __pm);" << '\n';
 	// header & serialization body
 	for (NBodyElem* elem : *st->body) {
 		IF_TYPE(elem, NCode, code) {
@@ -116,109 +404,237 @@ void compileRoot(NStruct* st) {
 			compileBlock(st, block);
 		} TYPE_UNKN(elem);
 	}
+	for (const output_field& f : fields)
+		compileWriteField(f);
 	// header ending
-	hout << "public:" << endl;
+	hout << "public:" << '\n';
+	if (!layout.empty()) {
+		hout << "\tstatic constexpr bool _is_raw() { return std::is_trivially_copyable_v<" << *st->name << "> && sizeof(" << *st->name << ") == ";
+		for (size_t i = 0; i < fields.size(); i++)
+			hout << (i ? " + " : "") << "sizeof(" << fields[i].name() << ")";
+		hout << "; }" << '\n';
+	}
+	hout << "\t"; if (st->isVirtual) hout << "virtual ";
+	hout << "void serialize_to(std::ostream& output, bool canonical = false) const;" << '\n';
+	hout << "\t"; if (st->isVirtual) hout << "virtual ";
+	hout << "void serialize_to(std::ostream& output, __as_context& context, bool canonical = false) const;" << '\n'
+		<< "\tsize_t serialize_to(char* output, size_t capacity, bool canonical = false) const;" << '\n';
+	hout << "\t"; if (st->isVirtual) hout << "virtual ";
+	hout << "bool serialize_indexed_to(std::ostream& output, bool canonical = false) const;" << '\n';
+	hout << "\t"; if (st->isVirtual) hout << "virtual ";
+	hout << "void serialize_framed_to(std::ostream& output, size_t block_size = 1 << 16, bool canonical = false) const;" << '\n'
+		<< "\tsize_t serialized_size() const;" << '\n'
+		<< "\tsize_t serialized_size(__as_context& context) const;" << '\n'
+		<< "\tstd::optional<uint64_t> content_hash() const;" << '\n'
+		<< "\tsize_t memory_footprint() const;" << '\n'
+		<< "\tsize_t memory_footprint(std::vector<std::pair<std::string, size_t>>& fields) const;" << '\n'
+		<< "\tbool deserialize_from(std::istream& source, std::function<bool(std::string)> error_callback);" << '\n'
+		<< "\tbool deserialize_from(std::istream& source, const std::function<bool(std::string)>& error_callback, __as_context& context);" << '\n'
+		<< "\tbool deserialize_framed_from(std::string_view source, std::function<bool(std::string)> error_callback, unsigned threads = 1);" << '\n'
+		<< "\tstatic size_t deserialize_many(const std::vector<std::string>& paths, " << *st->name << "* out, std::function<bool(size_t, std::string)> error_callback, unsigned threads = 0);" << '\n'
+		<< "\tstatic size_t deserialize_many(const std::vector<std::string_view>& buffers, " << *st->name << "* out, std::function<bool(size_t, std::string)> error_callback, unsigned threads = 0);" << '\n';
+	hout << "\t"; if (st->isVirtual) hout << "virtual ";
+	hout << "void _serialize_to(std::ostream& output, __serialization_state& pm) const;" << '\n';
 	hout << "\t"; if (st->isVirtual) hout << "virtual ";
-	hout << "void serialize_to(std::ostream& output) const;" << endl
-		<< "\tbool deserialize_from(std::istream& source, std::function<bool(std::string)> error_callback);" << endl;
+	hout << "void _serialized_size(__size_state& pm) const;" << '\n';
 	hout << "\t"; if (st->isVirtual) hout << "virtual ";
-	hout << "void _serialize_to(std::ostream& output, std::unordered_map<void*, std::function<void()>>& pm) const;" << endl
-		<< "\tbool _deserialize_from(std::istream& source, std::function<bool(std::string)> error_callback, std::unordered_map<size_t, __deserialization_ptr>& pm);" << endl
-		<< "\tstatic void* _deserialize_to_ptr(std::istream& source, std::function<bool(std::string)> error_callback, std::unordered_map<size_t, __deserialization_ptr>& pm);" << endl
-		<< "};" << endl << endl;
+	hout << "void _memory_heap(__footprint_state& pm) const;" << '\n';
+	hout << "\t"; if (st->isVirtual) hout << "virtual ";
+	hout << "void _memory_pointee(__footprint_state& pm) const;" << '\n'
+		<< "\tstatic void _serialize_columns(std::ostream& output, __serialization_state& pm, const char* first, size_t stride, size_t n);" << '\n'
+		<< "\tstatic bool _deserialize_columns(std::istream& source, const std::function<bool(std::string)>& error_callback, __deserialization_state& pm, char* first, size_t stride, size_t n);" << '\n'
+		<< "\tstatic void _serialized_size_columns(__size_state& pm, const char* first, size_t stride, size_t n);" << '\n'
+		<< "\tbool _deserialize_from(std::istream& source, const std::function<bool(std::string)>& error_callback, __deserialization_state& pm);" << '\n'
+		<< "\tstatic void* _deserialize_to_ptr(std::istream& source, const std::function<bool(std::string)>& error_callback, __deserialization_state& pm);" << '\n'
+		<< "#ifdef __AS_ASYNC" << '\n'
+		<< "\t"; if (st->isVirtual) hout << "virtual ";
+	hout << "__as_task _serialize_async(__as_async_buffer& output, __as_async_state& pm) const;" << '\n'
+		<< "\t__as_task serialize_async_to(__as_async_buffer& output) const;" << '\n'
+		<< "\tstatic __as_task _serialize_columns_async(__as_async_buffer& output, __as_async_state& pm, const char* first, size_t stride, size_t n);" << '\n'
+		<< "\tusing async_serializer = __as_async_serializer<" << *st->name << ">;" << '\n'
+		<< "#endif" << '\n'
+		<< "\tusing context = __as_context;" << '\n'
+		<< "\tusing lazy_source = __as_lazy_source;" << '\n'
+		<< "\tusing record_log_writer = __as_record_log_writer<" << *st->name << ">;" << '\n'
+		<< "\tusing record_log_reader = __as_record_log_reader<" << *st->name << ">;" << '\n'
+		<< "};" << '\n' << '\n';
 	// data ending
-	dout << "}" << endl << endl;
-	dout << "bool " << *st->name << "::_deserialize_from(istream& __s, function<bool(string)> __e, unordered_map<size_t, __deserialization_ptr>& __pm) {" << endl
-		<< "\t__TYPE_CHK(\"" << *st->name << "\");" << endl
-		<< "\tsize_t __count; __s >> __count;" << endl
-		<< "\tif (__count != " << fields_count << ") ""if (__e( \"'" << *st->name << "': read \" + to_string(__count) + \" fields, expected " << fields_count << "\")) return 0;" << endl;
+	dout << "}" << '\n' << '\n';
+	const size_t sparse_count = count_if(fields.begin(), fields.end(), is_sparse);
+	const string bad_count = sparse_count ? "__count > " + to_string(fields_count) + " || __count < " + to_string(fields_count - sparse_count)
+		: "__count != " + to_string(fields_count);
+	const string expected = sparse_count ? to_string(fields_count - sparse_count) + " to " + to_string(fields_count) : to_string(fields_count);
+	dout << "bool " << *st->name << "::_deserialize_from(__DS_ARGS) {" << '\n'
+		<< "\t__TYPE_CHK(\"" << *st->name << "\");" << '\n'
+		<< "\tsize_t __count; __s >> __count;" << '\n'
+		<< "\tif (" << bad_count << (layout.empty() ? "" : " && (__count != 1 || !_is_raw())")
+		<< ") ""if (__e( \"'" << *st->name << "': read \" + to_string(__count) + \" fields, expected " << expected << "\")) return 0;" << '\n';
+	// omitted `@sparse` fields are set to their default
+	if (sparse_count) {
+		dout << "\tif (__count < " << fields_count << ") {" << '\n'
+			<< "\t\tstatic const " << *st->name << " __d;" << '\n';
+		for (const output_field& f : fields)
+			if (is_sparse(f)) dout << "\t\t" << f.name() << " = __d." << f.name() << ";" << '\n';
+		dout << "\t}" << '\n';
+	}
+	// pointers used as arrays, whose size is checked against their `@length` field once every field is read
+	vector<const NVarDeclaration*> arrays;
+	for (const output_field& f : fields)
+		if (!length_field(*f.decls[0]->completeType).empty()) arrays.push_back(f.decls[0]);
+	if (!arrays.empty())
+		dout << "\tconst size_t __arrays = __pm.arrays.size();" << '\n';
 	// before fileds, deserialize parent classes
 	for (NParent* p : *st->parents)
-		dout << "\t" << *p->type << "::_deserialize_from(__s, __e, __pm);" << endl;
-	dout << "\tstatic const unordered_map<string, function<bool(" << *st->name << "&)>> __map = {" << endl;
+		dout << "\t" << *p->type << "::_deserialize_from(__s, __e, __pm);" << '\n';
+	dout << "\tstatic const unordered_map<string, bool(*)(" << *st->name << "&, __DS_ARGS)> __map = {" << '\n';
 	// add deserialization
-	for (NBodyElem* elem : *st->body) {
-		IF_TYPE(elem, NVarBlock, block)
-			compileDsBlock(st, block);
+	for (const output_field& f : fields)
+		compileDsField(st, f);
+	if (!layout.empty()) {
+		dout << "\t\t{\"#raw\", [](" << *st->name << "& __v, __DS_ARGS) -> bool {" << '\n'
+			<< "\t\t\t__TYPE_CHK(\"" << layout << "/\" + to_string(sizeof(" << *st->name << ")));" << '\n'
+			<< "\t\t\tif (!_is_raw()) { __e(__AS_CTX + \": the layout has padding, it can't be read as raw memory\"); return 0; }" << '\n'
+			<< "\t\t\t__s.ignore(1);" << '\n' // skip the whitespace separator
+			<< "\t\t\t__s.read((char*) &__v, sizeof(" << *st->name << "));" << '\n'
+			<< "\t\t\tif (__s.fail()) if (__e(__AS_CTX + \": reading the raw memory failed\")) return 0;" << '\n'
+			<< "\t\t\treturn 1;" << '\n'
+			<< "\t\t} }," << '\n';
 	}
-	dout << "\t};" << endl
-		<< "\tfor (size_t __i = 0; __i < __count; __i++) {" << endl
-		<< "\t\tstring __fn; __s >> __fn;" << endl
-		<< "\t\tconst auto& __itr = __map.find(__fn);" << endl
-		<< "\t\tif (__itr == __map.end()) if(__e(\"'" << *st->name << "': unknown field '\" + __fn + \"'\")) return 0;" << endl
+	dout << "\t};" << '\n'
+		<< "\tfor (size_t __i = 0; __i < __count; __i++) {" << '\n'
+		<< "\t\tstring& __fn = __pm.token; __s >> __fn;" << '\n'
+		<< "\t\tconst auto& __itr = __map.find(__fn);" << '\n'
+		<< "\t\tif (__itr == __map.end()) if(__e(\"'" << *st->name << "': unknown field '\" + __fn + \"'\")) return 0;" << '\n'
 		// return if the field fails deserializing
-		<< "\t\tif (!__itr->second(*this)) return 0;" << endl
-		<< "\t}" << endl
-		<< "\treturn 1;" << endl // got to the end -> success
-		<< "}" << endl << endl;
+		<< "\t\tif (!__itr->second(*this, __s, __e, __pm)) return 0;" << '\n'
+		<< "\t}" << '\n';
+	if (!arrays.empty()) {
+		dout << "\tfor (size_t __i = __arrays; __i < __pm.arrays.size(); __i++) {" << '\n'
+			<< "\t\tconst auto& __a = __pm.arrays[__i];" << '\n';
+		for (const NVarDeclaration* d : arrays) {
+			const string& fname = d->name->value;
+			const string length = length_field(*d->completeType);
+			dout << "\t\tif (__a.first == &" << fname << " && __a.second != (size_t) " << length << ")" << '\n'
+				<< "\t\t\tif (__e(__AS_CTX \"." << fname << ": read \" + to_string(__a.second) + \" values, but " << length
+				<< " is \" + to_string((size_t) " << length << "))) return 0;" << '\n';
+		}
+		dout << "\t}" << '\n'
+			<< "\t__pm.arrays.resize(__arrays);" << '\n';
+	}
+	dout << "\treturn 1;" << '\n' // got to the end -> success
+		<< "}" << '\n' << '\n';
 	// implement user-side methods
-	dout << "void " << *st->name << "::serialize_to(ostream& __s) const {" << endl
-		<< "\tunordered_map<void*, function<void()>> __pm;" << endl
-		<< "\t_serialize_to(__s, __pm);" << endl
-		<< "\tunordered_set<void*> __done;" << endl
-		<< "\twhile (!__pm.empty()) {" << endl
-		// avoid adding to the map while iterating
-		<< "\t\tauto __pmc = __pm;" << endl
-		<< "\t\t__pm.clear();" << endl
-		<< "\t\tfor (const auto& __p : __pmc) {" << endl
-		<< "\t\t\tif (__done.find(__p.first) != __done.end()) continue;" << endl // avoid endless recursion
-		<< "\t\t\telse __done.insert(__p.first);" << endl
-		<< "\t\t\t__s << ((size_t) __p.first) << ' ';" << endl
-		<< "\t\t\t__p.second();" << endl
-		<< "\t\t\t__s << \"\\n\";" << endl
-		<< "\t\t}" << endl
-		<< "\t}" << endl
-		<< "}" << endl << endl;
-	dout << "bool " << *st->name << "::deserialize_from(std::istream& __s, function<bool(string)> __e) {" << endl
-		<< "\tunordered_map<size_t, __deserialization_ptr> __pm;" << endl
-		<< "\tif (!_deserialize_from(__s, __e, __pm)) return 0;" << endl
-		<< "\tunordered_map<size_t, void*> __done;" << endl
-		<< "\twhile (!__pm.empty()) {" << endl
-		<< "\t\twhile (\" \\t\\n\\r\"s.find(__s.peek()) != string::npos) { __s.ignore(); }" << endl
-		<< "\t\tif (__s.peek() == EOF) break;" << endl
-		<< "\t\tsize_t __k; __s >> __k;" << endl
-		<< "\t\tconst auto& __it = __pm.find(__k);" << endl
-		<< "\t\tif (__it == __pm.end()) if (__e(\"definition of undeclared pointer: \" + to_string(__k))) return 0;" << endl
-		// avoid modifying the map while iterating
-		<< "\t\tconst auto __fun = __it->second.fun;" << endl
-		<< "\t\tconst auto __refs = move(__it->second.refs);" << endl
-		<< "\t\t__pm.erase(__it);" << endl
-		<< "\t\tvoid* __v;" << endl
-		<< "\t\tconst auto& __d_it = __done.find(__k);" << endl
-		// function callback returning nullptr indicates a failure
-		<< "\t\tif (__d_it == __done.end()) { __v = __done[__k] = __fun(); if (!__v) return 0; }" << endl
-		<< "\t\telse __v = __d_it->second;" << endl // avoid endless recursion
-		<< "\t\t__FILL_REFS;" << endl
-		<< "\t}" << endl
-		// expect all remaining entries to be in the `__done` map
-		<< "\tfor (const auto& __p : __pm) {" << endl
-		<< "\t\tsize_t __k = __p.first;" << endl
-		<< "\t\tconst auto& __refs = __p.second.refs;" << endl
-		<< "\t\tconst auto __it = __done.find(__k);" << endl
-		<< "\t\tif (__it == __done.end()) if (__e(\"unexpected EOF, pointer definition still missing: \" + to_string(__k))) return 0;" << endl
-		<< "\t\tvoid* __v = __it->second;" << endl
-		<< "\t\t__FILL_REFS;" << endl
-		<< "\t}" << endl
-		<< "\treturn 1;" << endl // got to the end -> success
-		<< "}" << endl << endl;
-	dout << "void* " << *st->name <<  "::_deserialize_to_ptr(std::istream& __s, std::function<bool(std::string)> __e, std::unordered_map<size_t, __deserialization_ptr>& __pm) {" << endl;
+	dout << "void " << *st->name << "::serialize_to(ostream& __s, bool __canonical) const {" << '\n'
+		<< "\t__as_context __ctx;" << '\n'
+		<< "\tserialize_to(__s, __ctx, __canonical);" << '\n'
+		<< "}" << '\n' << '\n';
+	dout << "void " << *st->name << "::serialize_to(ostream& __s, __as_context& __ctx, bool __canonical) const {" << '\n'
+		<< "\t__serialization_state& __pm = __ctx.writer;" << '\n'
+		<< "\t__pm.clear();" << '\n'
+		<< "\t__pm.canonical = __canonical;" << '\n'
+		<< "\t_serialize_to(__s, __pm);" << '\n'
+		// pointed values can add other values while being written
+		<< "\tfor (size_t __i = 0; __i < __pm.pending.size(); __i++) {" << '\n'
+		<< "\t\tconst __as_deferred_write __d = __pm.pending[__i];" << '\n'
+		<< "\t\t__pm.dict_clear();" << '\n'
+		<< "\t\t__s << (__i + 1) << ' ';" << '\n'
+		<< "\t\t__d.write(__d.value, __s, __pm);" << '\n'
+		<< "\t\t__s << \"\\n\";" << '\n'
+		<< "\t}" << '\n'
+		<< "}" << '\n' << '\n';
+	// the same output, followed by the offsets of the pointed values
+	dout << "bool " << *st->name << "::serialize_indexed_to(ostream& __s, bool __canonical) const {" << '\n'
+		<< "\tconst streampos __start = __s.tellp();" << '\n'
+		<< "\tif (__start == streampos(-1)) return 0;" << '\n'
+		<< "\t__as_context __ctx;" << '\n'
+		<< "\t__serialization_state& __pm = __ctx.writer;" << '\n'
+		<< "\t__pm.canonical = __canonical;" << '\n'
+		<< "\t_serialize_to(__s, __pm);" << '\n'
+		<< "\tvector<uint64_t> __offsets;" << '\n'
+		<< "\tfor (size_t __i = 0; __i < __pm.pending.size(); __i++) {" << '\n'
+		<< "\t\tconst __as_deferred_write __d = __pm.pending[__i];" << '\n'
+		<< "\t\t__pm.dict_clear();" << '\n'
+		<< "\t\t__offsets.push_back(__s.tellp() - __start);" << '\n'
+		<< "\t\t__s << (__i + 1) << ' ';" << '\n'
+		<< "\t\t__d.write(__d.value, __s, __pm);" << '\n'
+		<< "\t\t__s << \"\\n\";" << '\n'
+		<< "\t}" << '\n'
+		<< "\t__as_lazy_index::write(__s, __s.tellp() - __start, __offsets);" << '\n'
+		<< "\treturn __s.good();" << '\n'
+		<< "}" << '\n' << '\n';
+	// the same output, in blocks with checksums
+	dout << "void " << *st->name << "::serialize_framed_to(ostream& __out, size_t __block_size, bool __canonical) const {" << '\n'
+		<< "\t__as_framed_writer __b(__out, __block_size);" << '\n'
+		<< "\tostream __s(&__b);" << '\n'
+		<< "\tserialize_to(__s, __canonical);" << '\n'
+		<< "\t__b.finish();" << '\n'
+		<< "}" << '\n' << '\n';
+	// empty when the canonical output can't be written, e.g. with unorderable keys
+	dout << "optional<uint64_t> " << *st->name << "::content_hash() const {" << '\n'
+		<< "\t__as_hash_stream __h;" << '\n'
+		<< "\tserialize_to(__h, true);" << '\n'
+		<< "\tif (__h.fail()) return nullopt;" << '\n'
+		<< "\treturn __h.digest();" << '\n'
+		<< "}" << '\n' << '\n';
+	dout << "bool " << *st->name << "::deserialize_from(std::istream& __s, function<bool(string)> __e) {" << '\n'
+		<< "\t__as_context __ctx;" << '\n'
+		<< "\treturn deserialize_from(__s, __e, __ctx);" << '\n'
+		<< "}" << '\n' << '\n';
+	dout << "bool " << *st->name << "::deserialize_from(std::istream& __s, const __as_error_callback& __e, __as_context& __ctx) {" << '\n'
+		<< "\t__deserialization_state& __pm = __ctx.reader;" << '\n'
+		<< "\t__pm.clear();" << '\n'
+		<< "\tif (!_deserialize_from(__s, __e, __pm)) return 0;" << '\n'
+		// read the definitions of pointed values, until every referenced one is found
+		<< "\twhile (__pm.missing) {" << '\n'
+		<< "\t\t__s >> ws;" << '\n'
+		<< "\t\tif (__s.peek() == EOF) break;" << '\n'
+		<< "\t\tsize_t __k; __s >> __k;" << '\n'
+		<< "\t\tconst __deserialization_ptr* __d = __pm.ptrs.find(__k);" << '\n'
+		<< "\t\tif (!__d || __d->value) { if (__e(\"definition of undeclared pointer: \" + to_string(__k))) return 0; else continue; }" << '\n'
+		<< "\t\t__pm.strings.clear();" << '\n' // `@dict` strings are numbered in each value
+		// reading can add other values, the reference can be invalidated
+		<< "\t\tvoid* __v = __d->fun(__s, __e, __pm);" << '\n'
+		<< "\t\tif (!__v) return 0;" << '\n' // function callback returning nullptr indicates a failure
+		<< "\t\t__pm.ptrs.find(__k)->value = __v;" << '\n'
+		<< "\t\t__pm.missing--;" << '\n'
+		<< "\t}" << '\n'
+		<< "\treturn __pm.fill_refs(__e);" << '\n'
+		<< "}" << '\n' << '\n';
+	// every block is checked before reading anything
+	dout << "bool " << *st->name << "::deserialize_framed_from(string_view __data, function<bool(string)> __e, unsigned __threads) {" << '\n'
+		<< "\t__as_framed_buf __b;" << '\n'
+		<< "\tif (!__b.open(__data, __e, __threads)) return 0;" << '\n'
+		<< "\tistream __s(&__b);" << '\n'
+		<< "\treturn deserialize_from(__s, __e);" << '\n'
+		<< "}" << '\n' << '\n';
+	// the generated code has no shared mutable state, so every source is loaded independently
+	for (const string source : { "const vector<string>& __paths", "const vector<string_view>& __buffers" }) {
+		dout << "size_t " << *st->name << "::deserialize_many(" << source << ", " << *st->name << "* __out, function<bool(size_t, string)> __e, unsigned __threads) {" << '\n'
+			<< "\treturn __as_deserialize_many(" << source.substr(source.find("__")) << ", __out, __e, __threads);" << '\n'
+			<< "}" << '\n' << '\n';
+	}
+	dout << "void* " << *st->name <<  "::_deserialize_to_ptr(__DS_ARGS) {" << '\n';
 	int polym = getPolymOf(st->name);
 	if (!polym) { // standard pointer, no polymorphism involved
-		dout << "\t" << *st->name << "* __v = new " << *st->name << "();" << endl
-			<< "\t__v->_deserialize_from(__s, __e, __pm);" << endl
-			<< "\treturn __v;" << endl;
+		dout << "\t" << *st->name << "* __v = new " << *st->name << "();" << '\n'
+			<< "\t__v->_deserialize_from(__s, __e, __pm);" << '\n'
+			<< "\treturn __v;" << '\n';
 	} else {
 		// seek the type without eating it
-		dout << "\tstreampos __pos = __s.tellg();" << endl
-			<< "\tstring __t; __s >> __t;" << endl
-			<< "\t__s.seekg(__pos);" << endl
-			<< "\tconst auto __it = __polym_map_" << polym << ".find(__t);" << endl
+		dout << "\tstreampos __pos = __s.tellg();" << '\n'
+			<< "\tstring& __t = __pm.token; __s >> __t;" << '\n'
+			<< "\t__s.seekg(__pos);" << '\n'
+			<< "\tconst auto __it = __polym_map_" << polym << ".find(__t);" << '\n'
 			<< "\tif (__it == __polym_map_" << polym << ".end()) if (__e(\"unknown children type of '"
 			// returning nullptr indicates a failure and stops execution
-			<< *st->name << "': '\" + __t + \"'\")) return ((void*)nullptr);" << endl
-			<< "\treturn __it->second(__s, __e, __pm);" << endl;
+			<< *st->name << "': '\" + __t + \"'\")) return ((void*)nullptr);" << '\n'
+			<< "\treturn __it->second(__s, __e, __pm);" << '\n';
 	}
-	dout << "}" << endl << endl;
+	dout << "}" << '\n' << '\n';
+	compileSize(st, fields_count, layout);
+	compileFootprint(st);
+	compileColumns(st, fields_count);
+	compileAsync(st, fields_count, layout);
 }
 
 void openStream(ofstream& stream, const char* arg) {
@@ -236,30 +652,33 @@ int main(int argc, char **argv) {
 	// initialize types map
 	init_types();
 
-	hout << "#pragma once" << endl
-		<< "#include <functional>" << endl // for callbacks
-		<< "#include <unordered_map>" << endl // for state
-		<< "#include <iosfwd>" << endl // for (de)serialization input/output
-		<< "struct __deserialization_ptr;" << endl;
-	dout << "#include \"" << argv[2] << "\"" << endl
-		<< "#include <ostream>" << endl
-		<< "#include <istream>" << endl
-		<< "#include <functional>" << endl
-		<< "#include <vector>" << endl
-		<< "#include <unordered_set>" << endl
-		<< "using namespace std;" << endl << endl
-		<< "#define __TYPE_CHK(exp) do { \\" << endl
-		<< "\t\tstring __tname; __s >> __tname; \\" << endl
-		<< "\t\tif (__tname != exp && __e(__AS_CTX + \": expected type '\"s + exp + \"', got '\" + __tname + \"'\")) return 0; \\" << endl
-		<< "\t} while (false)" << endl << endl
-		<< "#define __FILL_REFS do { \\" << endl
-		<< "\t\tfor (void* __r : __refs) \\" << endl
-		<< "\t\t\t* (void**) __r = __v; \\" << endl // they are guaranteed to be pointers to pointers
-		<< "\t} while (false);" << endl << endl
-		<< "struct __deserialization_ptr {" << endl
-		<< "\tvector<void*> refs;" << endl
-		<< "\tfunction<void*()> fun;" << endl
-		<< "};" << endl << endl;
+	hout << "#pragma once" << '\n'
+		<< "#include <functional>" << '\n' // for callbacks
+		<< "#include <unordered_map>" << '\n' // for state
+		<< "#include <iosfwd>" << '\n' // for (de)serialization input/output
+		<< "#include <cstdint>" << '\n'
+		<< "#include <type_traits>" << '\n'; // for raw layouts
+	emit_runtime(argv[2], hout);
+	dout << "#define AS_RUNTIME_IO" << '\n' // the generated code reads files and loads in parallel
+		<< "#include \"" << argv[2] << "\"" << '\n'
+		<< "#include <ostream>" << '\n'
+		<< "#include <istream>" << '\n'
+		<< "#include <functional>" << '\n'
+		<< "#include <vector>" << '\n'
+		<< "#include <memory>" << '\n'
+		<< "#include <cstring>" << '\n'
+		<< "#include <algorithm>" << '\n'
+		<< "#include <type_traits>" << '\n'
+		<< "#include <unordered_set>" << '\n'
+		<< "using namespace std;" << '\n' << '\n'
+		<< "#define __TYPE_CHK(exp) do { \\" << '\n'
+		<< "\t\tstring& __tname = __pm.token; __s >> __tname; \\" << '\n'
+		<< "\t\tif (__tname != exp && __e(__AS_CTX + \": expected type '\"s + exp + \"', got '\" + __tname + \"'\")) return 0; \\" << '\n'
+		<< "\t} while (false)" << '\n' << '\n'
+		// parameters of the field deserialization functions
+		<< "#define __DS_ARGS istream& __s, const __as_error_callback& __e, __deserialization_state& __pm" << '\n' << '\n'
+		// suspension point of the coroutine-based serializer
+		<< "#define __AS_YIELD if (__w.full()) co_await __w.drained()" << '\n' << '\n';
 
 	yyparse();
 
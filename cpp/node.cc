@@ -1,66 +1,108 @@
 #include <node.hh>
 #include <ostream>
-#include <sstream>
+#include <memory>
+#include <unordered_map>
 
 using namespace std;
 
-// converts to the internal name format
-string to_string(const NType& t) {
-	stringstream ss;
-	ss << t;
-	return ss.str();
+// big blocks, each node is carved out of the last one
+static vector<unique_ptr<char[]>> arena_blocks;
+static size_t arena_used = 0, arena_size = 0;
+
+void* ast_alloc(size_t size) {
+	constexpr size_t align = alignof(max_align_t), block = 64 * 1024;
+	size = (size + align - 1) & ~(align - 1);
+	if (arena_used + size > arena_size) {
+		arena_size = max(size, block);
+		arena_blocks.emplace_back(new char[arena_size]);
+		arena_used = 0;
+	}
+	void* p = arena_blocks.back().get() + arena_used;
+	arena_used += size;
+	return p;
 }
 
-// converts to the internal name format
-ostream& operator<<(ostream& o, const NType& t) {
-	if (t.isArray) // `name` is the array size
-		o << "[]";
-	else // `name` is the actual type
-		o << t.name->value;
-	GenericsList& list = *t.generics;
-	if (list.empty()) return o;
-	o << "<";
+namespace {
+struct type_key {
+	string name;
+	GenericsList generics;
+	bool isArray;
+	bool operator==(const type_key& o) const {
+		return isArray == o.isArray && name == o.name && generics == o.generics;
+	}
+};
+struct type_key_hash {
+	size_t operator()(const type_key& k) const {
+		size_t h = hash<string>()(k.name) + k.isArray;
+		for (const NType* g : k.generics) // generics are interned, their address is enough
+			h = h * 31 + hash<const NType*>()(g);
+		return h;
+	}
+};
+}
+
+static unordered_map<type_key, const NType*, type_key_hash> interned_types;
+
+// builds the internal name, from the ones of the generics
+static string internal_name(const NType& t) {
+	string res = t.isArray ? "[]" : t.name->value; // `name` may be the array size
+	const GenericsList& list = *t.generics;
+	if (list.empty()) return res;
+	res += "<";
 	for (int i = 0; i < list.size(); i++) {
-		o << *list[i];
-		if (i != list.size() - 1) o << ","; // no whitespaces!
+		res += list[i]->internal;
+		if (i != list.size() - 1) res += ","; // no whitespaces!
 	}
-	o << ">";
-	return o;
+	res += ">";
+	return res;
 }
 
-// converts to the C++ name format
-string to_cpp_type(const NType& t) {
-	GenericsList& list = *t.generics;
-	string& name = t.name->value;
+// builds the C++ name, from the ones of the generics
+static string cpp_name(const NType& t) {
+	const GenericsList& list = *t.generics;
+	const string& name = t.name->value;
 	if (t.isArray) // `name` is the array size
-		return to_cpp_type(*list[0]) + "[" + t.name->value + "]";
-	if (name == "*")
-		return to_cpp_type(*list[0]) + "*";
+		return list[0]->cpp + "[" + t.name->value + "]";
+	if (name == "*" || name == "*[]")
+		return list[0]->cpp + "*";
+	if (name == "columnar" || name == "packed" || name == "dict")
+		return list[0]->cpp;
+	if (name == "lazy")
+		return "__as_lazy<" + list[0]->cpp + ">";
 	if (list.empty())
 		return name;
 	string res = name;
 	res += "<";
 	for (int i = 0; i < list.size(); i++) {
-		res += to_cpp_type(*list[i]);
+		res += list[i]->cpp;
 		if (i != list.size() - 1) res += ","; // no whitespaces!
 	}
 	res += ">";
 	return res;
 }
 
-bool operator==(const NType& a, const NType& b) {
-	if (a.name->value != b.name->value) return false;
-	if (a.generics->size() != b.generics->size()) return false;
-	for (int i = 0; i < a.generics->size(); i++)
-		if ((*a.generics)[i] != (*b.generics)[i]) return false;
-	return true;
+const NType* NType::get(segment_t pos, string name, GenericsList generics, bool isArray) {
+	type_key key{ std::move(name), std::move(generics), isArray };
+	auto itr = interned_types.find(key);
+	if (itr != interned_types.end()) return itr->second;
+	NType* t = new NType(pos, new NIdentifier(pos, string(key.name)), new GenericsList(key.generics), isArray);
+	t->internal = internal_name(*t);
+	t->cpp = cpp_name(*t);
+	interned_types.emplace(std::move(key), t);
+	return t;
 }
 
-size_t hash<NType>::operator()(const NType& t) const {
-	size_t h = hash<string>()(t.name->value);
-	for (const NType* o : *t.generics) {
-		h *= 7;
-		h += 13 * (*this)(*o); // (*this) is this hash functor
-	}
-	return h;
+// converts to the internal name format
+const string& to_string(const NType& t) {
+	return t.internal;
+}
+
+// converts to the internal name format
+ostream& operator<<(ostream& o, const NType& t) {
+	return o << t.internal;
+}
+
+// converts to the C++ name format
+const string& to_cpp_type(const NType& t) {
+	return t.cpp;
 }
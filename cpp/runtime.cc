@@ -0,0 +1,1741 @@
+#include <runtime.hh>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// read-only stream buffer over memory owned by someone else
+static const char* membuf_code = R"__AS(
+#ifndef __AS_MEMBUF
+#define __AS_MEMBUF
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <streambuf>
+#include <string>
+#include <string_view>
+struct __as_membuf : std::streambuf {
+	__as_membuf(const char* data, size_t size) {
+		char* p = const_cast<char*>(data);
+		setg(p, p, p + size);
+	}
+protected:
+	// tellg and seekg are used to peek at polymorphic types
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+		if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+		char* base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+		if (base + off < eback() || base + off > egptr()) return pos_type(off_type(-1));
+		setg(eback(), base + off, egptr());
+		return pos_type(gptr() - eback());
+	}
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+};
+// write-only stream buffer over a fixed memory area, the stream fails when it is full
+struct __as_out_membuf : std::streambuf {
+	__as_out_membuf(char* data, size_t size) { setp(data, data + size); }
+	size_t written() const { return pptr() - pbase(); }
+};
+// write-only stream buffer which grows as needed, and keeps its memory when cleared
+struct __as_growing_membuf : std::streambuf {
+	void clear() { setp(&data_[0], &data_[0] + data_.size()); }
+	std::string_view view() const { return std::string_view(pbase(), pptr() - pbase()); }
+protected:
+	int_type overflow(int_type c) override {
+		size_t n = pptr() - pbase();
+		data_.resize(std::max<size_t>(256, 2 * data_.size()));
+		setp(&data_[0], &data_[0] + data_.size());
+		for (; n > INT_MAX; n -= INT_MAX) pbump(INT_MAX); // pbump takes an int
+		pbump((int) n);
+		if (!traits_type::eq_int_type(c, traits_type::eof())) sputc(traits_type::to_char_type(c));
+		return traits_type::not_eof(c);
+	}
+private:
+	std::string data_;
+};
+#endif
+)__AS";
+
+/* pointer graphs of the serializer and of the deserializer.
+ * when writing, pointed values get sequential ids, in the order in which they are found,
+ * and are written in the same order after the root object.
+ * every state can be cleared and reused, keeping its memory, to avoid allocations */
+static const char* graph_code = R"__AS(
+#ifndef __AS_GRAPH
+#define __AS_GRAPH
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+// open addressing hash table of ids, which keeps its slots (and the values in them) when cleared
+template<typename V>
+class __as_id_table {
+public:
+	// returns nullptr if the key was not inserted
+	V* find(size_t key) {
+		if (slots_.empty()) return nullptr;
+		for (size_t i = hash(key); ; i = (i + 1) & (slots_.size() - 1)) {
+			slot& s = slots_[i];
+			if (s.gen != gen_) return nullptr;
+			if (s.key == key) return &s.value;
+		}
+	}
+	// returns the value of `key`, and whether it was inserted now (then the value is empty)
+	V& get(size_t key, bool& created) {
+		if (V* v = find(key)) { created = false; return *v; }
+		if (2 * (used_.size() + 1) > slots_.size()) grow();
+		size_t i = hash(key);
+		while (slots_[i].gen == gen_) i = (i + 1) & (slots_.size() - 1);
+		slot& s = slots_[i];
+		s.key = key;
+		s.gen = gen_;
+		if constexpr (std::is_class_v<V>) s.value.clear();
+		else s.value = V();
+		used_.push_back(i);
+		created = true;
+		return s.value;
+	}
+	template<typename F>
+	void for_each(F&& f) {
+		for (size_t i : used_) f(slots_[i].key, slots_[i].value);
+	}
+	size_t size() const { return used_.size(); }
+	// the n-th inserted key and value, which stay in place while inserting others
+	size_t key_at(size_t n) const { return slots_[used_[n]].key; }
+	V& value_at(size_t n) { return slots_[used_[n]].value; }
+	void clear() {
+		used_.clear();
+		if (++gen_ == 0) { // the generation wrapped around, the slots must be reset
+			for (slot& s : slots_) s.gen = 0;
+			gen_ = 1;
+		}
+	}
+private:
+	struct slot {
+		size_t key = 0;
+		uint32_t gen = 0; // the slot is used when it is equal to `gen_`
+		V value;
+	};
+	std::vector<slot> slots_;
+	std::vector<size_t> used_;
+	uint32_t gen_ = 1;
+
+	size_t hash(size_t key) const {
+		return (size_t) ((uint64_t) key * 0x9e3779b97f4a7c15ULL >> 32) & (slots_.size() - 1);
+	}
+	void grow() {
+		std::vector<slot> old(std::max<size_t>(16, 2 * slots_.size()));
+		old.swap(slots_); // the new slots are empty
+		std::vector<size_t> used;
+		used.swap(used_);
+		gen_ = 1;
+		for (size_t i : used) {
+			size_t j = hash(old[i].key);
+			while (slots_[j].gen == gen_) j = (j + 1) & (slots_.size() - 1);
+			slots_[j].key = old[i].key;
+			slots_[j].gen = gen_;
+			slots_[j].value = std::move(old[i].value);
+			used_.push_back(j);
+		}
+	}
+};
+
+template<typename F>
+struct __as_pointer_graph {
+	__as_id_table<size_t> ids;
+	std::vector<F> pending; // the writer of the value with id `i` is at `i - 1`
+	bool canonical = false; // unordered containers are written in sorted order
+	// strings of `@dict` fields, by number, chained by hash: the tables keep their memory when cleared
+	std::vector<std::string_view> strings;
+	std::vector<size_t> string_next; // the previous string with the same hash, plus one
+	__as_id_table<size_t> string_heads; // the last string of each hash, plus one
+	std::vector<char> scratch; // the values of native columns, grown on demand and kept when cleared
+
+	// returns the id of an already found value, or 0
+	size_t find(const void* p) {
+		size_t* id = ids.find((size_t) p);
+		return id ? *id : 0;
+	}
+	// returns the new id of `p`, which will be written by `write`
+	size_t add(const void* p, F write) {
+		pending.push_back(std::move(write));
+		bool created;
+		return ids.get((size_t) p, created) = pending.size();
+	}
+	// numbers the strings of `@dict` fields: returns true, with the number, if `s` was already written
+	bool dict_find(std::string_view s, size_t& id) {
+		bool created;
+		size_t& head = string_heads.get(std::hash<std::string_view>()(s), created);
+		for (size_t i = head; i; i = string_next[i - 1])
+			if (strings[i - 1] == s) { id = i - 1; return true; }
+		id = strings.size();
+		strings.push_back(s);
+		string_next.push_back(head);
+		head = id + 1;
+		return false;
+	}
+	// the strings are numbered again in every value written: the root object, and each pointed value
+	void dict_clear() {
+		if (strings.empty()) return;
+		strings.clear();
+		string_next.clear();
+		string_heads.clear();
+	}
+	void clear() {
+		ids.clear();
+		pending.clear();
+		canonical = false;
+		dict_clear();
+	}
+	char* scratch_for(size_t n) {
+		if (scratch.size() < n) scratch.resize(n);
+		return scratch.data();
+	}
+};
+
+/* canonical order of the elements of unordered containers, by key: keys with `<`, and pointers
+ * by the id of the value they point to, so that the order doesn't depend on addresses. pointed values
+ * not written yet come after the others, ordered by their content: by `content_hash`, computed once
+ * for each of them, or by `<`. if they have neither, the order fails */
+template<typename T, typename = void> struct __as_is_ordered : std::false_type {};
+template<typename T> struct __as_is_ordered<T, std::void_t<decltype(std::declval<const T&>() < std::declval<const T&>())>> : std::true_type {};
+template<typename T, typename = void> struct __as_has_content_hash : std::false_type {};
+template<typename T> struct __as_has_content_hash<T, std::void_t<decltype(std::declval<const T&>().content_hash())>> : std::true_type {};
+template<typename T> struct __as_pointer_key : std::false_type {};
+template<typename T> struct __as_pointer_key<T*> : std::true_type { static T* get(T* p) { return p; } };
+template<typename T> struct __as_pointer_key<std::shared_ptr<T>> : std::true_type { static T* get(const std::shared_ptr<T>& p) { return p.get(); } };
+template<typename T, typename D> struct __as_pointer_key<std::unique_ptr<T, D>> : std::true_type { static T* get(const std::unique_ptr<T, D>& p) { return p.get(); } };
+
+// pointers to the elements of `c`, in canonical order; returns false if its keys can't be ordered (and there are more than one)
+template<typename G, typename C>
+bool __as_canonical_order(G& pm, const C& c, std::vector<const typename C::value_type*>& out) {
+	using K = typename C::key_type;
+	using E = typename C::value_type;
+	out.clear();
+	for (const auto& e : c) out.push_back(&e);
+	const auto key = [](const E* e) -> const K& {
+		if constexpr (std::is_same_v<K, E>) return *e;
+		else return e->first;
+	};
+	if constexpr (__as_pointer_key<K>::value) {
+		using T = std::remove_cv_t<std::remove_pointer_t<decltype(__as_pointer_key<K>::get(std::declval<const K&>()))>>;
+		// null first, then by id, then the values not written yet by content, hashed once each
+		struct entry { size_t id; uint64_t hash; const E* e; };
+		std::vector<entry> d;
+		d.reserve(out.size());
+		size_t unwritten = 0;
+		for (const E* e : out) {
+			const T* p = __as_pointer_key<K>::get(key(e));
+			const size_t id = !p ? 0 : pm.find(p) ? pm.find(p) : SIZE_MAX;
+			uint64_t hash = 0;
+			if (id == SIZE_MAX) {
+				unwritten++;
+				if constexpr (__as_has_content_hash<T>::value) {
+					const auto h = p->content_hash();
+					if (!h) return false;
+					hash = *h;
+				}
+			}
+			d.push_back({ id, hash, e });
+		}
+		if constexpr (!__as_has_content_hash<T>::value && !__as_is_ordered<T>::value)
+			if (unwritten > 1) return false;
+		std::sort(d.begin(), d.end(), [&](const entry& a, const entry& b) {
+			if (a.id != b.id || a.id != SIZE_MAX) return a.id < b.id;
+			if constexpr (__as_has_content_hash<T>::value) return a.hash < b.hash;
+			else if constexpr (__as_is_ordered<T>::value) return *__as_pointer_key<K>::get(key(a.e)) < *__as_pointer_key<K>::get(key(b.e));
+			else return false;
+		});
+		for (size_t i = 0; i < d.size(); i++) out[i] = d[i].e;
+		return true;
+	} else if constexpr (__as_is_ordered<K>::value) {
+		std::sort(out.begin(), out.end(), [&](const E* a, const E* b) { return key(a) < key(b); });
+		return true;
+	} else {
+		return out.size() < 2;
+	}
+}
+
+// pointed values are written later by captureless functions, which don't allocate
+struct __serialization_state;
+struct __as_deferred_write {
+	const void* value;
+	void (*write)(const void* value, std::ostream& s, __serialization_state& pm);
+};
+struct __serialization_state : __as_pointer_graph<__as_deferred_write> {};
+
+struct __deserialization_state;
+class __as_lazy_source;
+using __as_error_callback = std::function<bool(std::string)>;
+// a shared pointer to fill, by a captureless function: the first one creates the owner, the others share it
+struct __as_shared_ref {
+	void* target;
+	void (*fill)(void* target, void* value, std::shared_ptr<void>& owner);
+};
+// a pointed value, which is read once its definition is found
+struct __deserialization_ptr {
+	std::vector<void*> refs; // pointers to fill
+	std::vector<__as_shared_ref> shared_refs; // shared pointers to fill
+	void* (*fun)(std::istream&, const __as_error_callback&, __deserialization_state&) = nullptr;
+	void* value = nullptr; // set once read
+	void clear() { refs.clear(); shared_refs.clear(); fun = nullptr; value = nullptr; }
+};
+// elements of a set, inserted once the pointers in them are filled
+struct __as_deferred_insert {
+	void* container;
+	void* values;
+	void (*finish)(void* container, void* values, bool insert);
+};
+struct __deserialization_state {
+	__as_id_table<__deserialization_ptr> ptrs;
+	std::vector<__as_deferred_insert> inserts;
+	size_t missing = 0; // referenced values whose definition was not read yet
+	std::string token; // reused for field and type names
+	// pointers used as arrays and the sizes read, checked by the structs being read against their `@length` fields
+	std::vector<std::pair<const void*, size_t>> arrays;
+	__as_lazy_source* lazy = nullptr; // when set, `@lazy` fields are read from it on demand
+	std::vector<std::shared_ptr<std::string>> strings; // strings of `@dict` fields, by number, in the value being read
+	// owners of the values read by shared pointers, by id, when they must outlive this state (e.g. lazy sources)
+	std::unordered_map<size_t, std::shared_ptr<void>>* owners = nullptr;
+	std::vector<char> scratch; // the values of native columns, grown on demand and kept when cleared
+
+	// the value with id `id`, to which a new reference was found
+	__deserialization_ptr& ref(size_t id) {
+		bool created;
+		__deserialization_ptr& d = ptrs.get(id, created);
+		if (created) missing++;
+		return d;
+	}
+	__deserialization_state() {}
+	__deserialization_state(const __deserialization_state&) = delete;
+	__deserialization_state& operator=(const __deserialization_state&) = delete;
+	~__deserialization_state() { finish_inserts(false); }
+	void clear() {
+		ptrs.clear();
+		finish_inserts(false);
+		missing = 0;
+		arrays.clear();
+		lazy = nullptr;
+		strings.clear();
+		owners = nullptr;
+	}
+	char* scratch_for(size_t n) {
+		if (scratch.size() < n) scratch.resize(n);
+		return scratch.data();
+	}
+	// the elements of `c` are read into `values`, whose addresses don't change, and inserted at the end
+	template<typename C, typename V>
+	void insert_later(C& c, std::vector<V>* values) {
+		inserts.push_back({ &c, values, [](void* c, void* v, bool insert) {
+			auto* values = (std::vector<V>*) v;
+			if (insert) ((C*) c)->insert(std::make_move_iterator(values->begin()), std::make_move_iterator(values->end()));
+			delete values;
+		} });
+	}
+	void finish_inserts(bool insert) {
+		for (const __as_deferred_insert& d : inserts) d.finish(d.container, d.values, insert);
+		inserts.clear();
+	}
+	// reads a string of a `@dict` field: `=<number>` if already read, or `<size> <chars>`
+	const std::shared_ptr<std::string>* dict_read(std::istream& s) {
+		s >> std::ws;
+		if (s.peek() == '=') {
+			s.get();
+			size_t id;
+			s >> id;
+			return s && id < strings.size() ? &strings[id] : nullptr;
+		}
+		size_t n;
+		s >> n;
+		if (!s) return nullptr;
+		auto str = std::make_shared<std::string>(n, '\0');
+		s.ignore(1); // skip the whitespace separator
+		s.read(&(*str)[0], n);
+		if (!s) return nullptr;
+		strings.push_back(std::move(str));
+		return &strings.back();
+	}
+	// fills the pointers to the values read, once every value was read
+	bool fill_refs(const __as_error_callback& e) {
+		bool ok = true;
+		ptrs.for_each([&](size_t k, __deserialization_ptr& d) {
+			if (!ok) return;
+			if (!d.value) { ok = !e("unexpected EOF, pointer definition still missing: " + std::to_string(k)); return; }
+			for (void* r : d.refs)
+				* (void**) r = d.value; // they are guaranteed to be pointers to pointers
+			if (d.shared_refs.empty()) return;
+			std::shared_ptr<void> local; // shared pointers to the same value share the owner
+			std::shared_ptr<void>& owner = owners ? (*owners)[k] : local;
+			for (const __as_shared_ref& r : d.shared_refs)
+				r.fill(r.target, d.value, owner);
+		});
+		finish_inserts(ok);
+		return ok;
+	}
+};
+#endif
+)__AS";
+
+// counts the bytes written by `serialize_to`, without formatting the values
+static const char* size_code = R"__AS(
+#ifndef __AS_SIZE
+#define __AS_SIZE
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+struct __size_state;
+struct __as_deferred_size {
+	const void* value;
+	void (*size)(const void* value, __size_state& pm);
+};
+struct __size_state : __as_pointer_graph<__as_deferred_size> {
+	size_t size = 0;
+	void clear() {
+		__as_pointer_graph<__as_deferred_size>::clear();
+		size = 0;
+	}
+};
+// length of an integer, as written by `operator<<`
+template<typename I>
+size_t __as_digits(I value) {
+	using U = std::make_unsigned_t<I>;
+	size_t n = 1;
+	U v = value;
+	if constexpr (std::is_signed_v<I>) if (value < 0) { n++; v = U(0) - v; }
+	for (; v >= 10; v /= 10) n++;
+	return n;
+}
+/* floating point values are written with the default precision, like `%g`: 6 significant digits, without
+ * trailing zeros, in scientific notation when the exponent is below -4 or above 5. the digits are found
+ * by scaling the value, and only values too close to a rounding tie (or not finite) are formatted */
+inline size_t __as_float_size(double value) {
+	if (!std::isfinite(value)) return std::snprintf(nullptr, 0, "%g", value);
+	if (value == 0) return std::signbit(value) ? 2 : 1;
+	static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const double a = std::fabs(value);
+	int e = (int) std::floor(std::log10(a));
+	double scaled = 0; // the 6 significant digits, in [1e5, 1e6)
+	for (int i = 0; i < 3; i++) {
+		const int k = 5 - e;
+		scaled = k >= 0 ? (k <= 22 ? a * pow10[k] : a * 1e22 * std::pow(10.0, k - 22))
+			: (k >= -22 ? a / pow10[-k] : a / std::pow(10.0, -k));
+		if (scaled >= 1e6) e++;
+		else if (scaled < 1e5) e--;
+		else break;
+	}
+	if (!(scaled >= 1e5 && scaled < 1e6) || std::fabs(scaled - std::floor(scaled) - 0.5) < 1e-6)
+		return std::snprintf(nullptr, 0, "%g", value);
+	uint32_t m = (uint32_t) std::lround(scaled);
+	if (m == 1000000) { m = 100000; e++; } // rounded up to the next power of 10
+	size_t digits = 6;
+	for (; m % 10 == 0; m /= 10) digits--;
+	size_t n = value < 0;
+	if (e < -4 || e >= 6) n += digits + (digits > 1) + 2 + (e <= -100 || e >= 100 ? 3 : 2); // `d.ddde+XX`
+	else if (e >= 0) n += e + 1 + (digits > (size_t) e + 1 ? digits - e : 0); // `ddd.ddd`
+	else n += 1 - e + digits; // `0.000ddd`
+	return n;
+}
+#endif
+)__AS";
+
+// memory owned by an object graph, for `memory_footprint`: every pointed value is counted once
+static const char* footprint_code = R"__AS(
+#ifndef __AS_FOOTPRINT
+#define __AS_FOOTPRINT
+#include <cstddef>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+struct __footprint_state;
+struct __as_deferred_footprint {
+	const void* value;
+	void (*heap)(const void* value, __footprint_state& pm);
+};
+struct __footprint_state {
+	size_t bytes = 0;
+	std::unordered_set<const void*> visited;
+	std::vector<__as_deferred_footprint> pending; // pointed values are counted later, so that long chains don't recurse
+	std::vector<std::pair<std::string, size_t>>* fields = nullptr; // the breakdown of the object measured
+	// false for null pointers and values already counted
+	bool first(const void* p) {
+		return p && visited.insert(p).second;
+	}
+	void count_pending() {
+		while (!pending.empty()) {
+			const __as_deferred_footprint d = pending.back();
+			pending.pop_back();
+			d.heap(d.value, *this);
+		}
+	}
+};
+// the buffer of a string, unless it is stored inline
+inline size_t __as_string_heap(const std::string& s) {
+	const char* p = s.data();
+	if (p >= (const char*) &s && p < (const char*) (&s + 1)) return 0;
+	return s.capacity() + 1;
+}
+// an estimate for containers with a node per element, holding the value and a few pointers
+template<typename C>
+size_t __as_node_heap(const C& c, size_t pointers) {
+	return c.size() * (sizeof(typename C::value_type) + pointers * sizeof(void*));
+}
+// an estimate for the control block of shared pointers: two counters and the deleter
+constexpr size_t __as_shared_block = 2 * sizeof(long) + sizeof(void*);
+#endif
+)__AS";
+
+/* values of `@bits` and `@range` fields, packed into hex digits: the lowest bits of the first value
+ * go into the first digit. the digits are buffered, and the last one is padded with zeroes */
+static const char* bits_code = R"__AS(
+#ifndef __AS_BITS
+#define __AS_BITS
+#include <cstdint>
+#include <istream>
+#include <ostream>
+class __as_bit_writer {
+public:
+	explicit __as_bit_writer(std::ostream& s) : s_(s) {}
+	void put(uint64_t v, unsigned bits) {
+		for (; bits > 32; bits -= 32, v >>= 32) put(v & 0xffffffff, 32);
+		acc_ |= (v & ((uint64_t(1) << bits) - 1)) << n_; // less than 4 bits are left
+		for (n_ += bits; n_ >= 4; n_ -= 4, acc_ >>= 4) {
+			if (len_ == sizeof(buf_)) flush();
+			buf_[len_++] = "0123456789abcdef"[acc_ & 15];
+		}
+	}
+	void finish() {
+		if (n_) put(0, 4 - n_);
+		flush();
+	}
+private:
+	std::ostream& s_;
+	uint64_t acc_ = 0;
+	unsigned n_ = 0;
+	char buf_[64];
+	size_t len_ = 0;
+	void flush() {
+		s_.write(buf_, len_);
+		len_ = 0;
+	}
+};
+class __as_bit_reader {
+public:
+	explicit __as_bit_reader(std::istream& s) : s_(s) {}
+	// sets the failbit of the stream on invalid digits
+	uint64_t get(unsigned bits) {
+		if (bits > 32) {
+			uint64_t low = get(32);
+			return low | get(bits - 32) << 32;
+		}
+		if (!started_) { s_ >> std::ws; started_ = true; }
+		for (; n_ < bits; n_ += 4) {
+			int c = s_.get();
+			int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+			if (d < 0) { s_.setstate(std::ios_base::failbit); return 0; }
+			acc_ |= uint64_t(d) << n_;
+		}
+		uint64_t v = acc_ & ((uint64_t(1) << bits) - 1);
+		acc_ >>= bits;
+		n_ -= bits;
+		return v;
+	}
+private:
+	std::istream& s_;
+	uint64_t acc_ = 0;
+	unsigned n_ = 0;
+	bool started_ = false;
+};
+#endif
+)__AS";
+
+/* keeps the memory used by (de)serialization between calls: a context can be kept by every thread,
+ * so that in the steady state only the deserialized values are allocated */
+static const char* context_code = R"__AS(
+#ifndef __AS_CONTEXT
+#define __AS_CONTEXT
+struct __as_context {
+	__serialization_state writer;
+	__size_state size;
+	__deserialization_state reader;
+};
+// the types of the classes, defined with the file formats
+template<typename T> class __as_record_log_writer;
+template<typename T> class __as_record_log_reader;
+#endif
+)__AS";
+
+// hashes everything written to it, without storing it
+static const char* hash_code = R"__AS(
+#ifndef __AS_HASH
+#define __AS_HASH
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <ostream>
+#include <streambuf>
+class __as_hash_stream : private std::streambuf, public std::ostream {
+public:
+	__as_hash_stream() : std::ostream(this) { setp(block_, block_ + sizeof(block_)); }
+	uint64_t digest() {
+		size_t n = pptr() - pbase(), words = n / 8;
+		for (size_t i = 0; i < words; i++) mix(word(block_ + 8 * i));
+		uint64_t tail = 0;
+		memcpy(&tail, block_ + 8 * words, n - 8 * words);
+		mix(tail);
+		uint64_t h = h_ ^ (length_ + n);
+		h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+		return h ^ (h >> 33);
+	}
+private:
+	// blocks are a multiple of 8 bytes, so words don't depend on how the output is split
+	char block_[4096];
+	uint64_t h_ = 0x9e3779b97f4a7c15ULL, length_ = 0;
+
+	static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	static uint64_t word(const char* p) { uint64_t w; memcpy(&w, p, 8); return w; }
+	void mix(uint64_t w) {
+		w *= 0x87c37b91114253d5ULL; w = rotl(w, 31); w *= 0x4cf5ad432745937fULL;
+		h_ ^= w; h_ = rotl(h_, 27) * 5 + 0x52dce729;
+	}
+	using traits = std::streambuf::traits_type;
+	std::streambuf::int_type overflow(std::streambuf::int_type c) override {
+		for (size_t i = 0; i < sizeof(block_); i += 8) mix(word(block_ + i));
+		length_ += sizeof(block_);
+		setp(block_, block_ + sizeof(block_));
+		if (!traits::eq_int_type(c, traits::eof())) sputc(traits::to_char_type(c));
+		return traits::not_eof(c);
+	}
+};
+#endif
+)__AS";
+
+/* loads many independent sources on a pool of threads: every thread owns a range of indexes,
+ * and when it is done it steals the second half of the largest remaining range.
+ * the generated code has no shared mutable state, so sources are loaded concurrently */
+static const char* parallel_code = R"__AS(
+#ifndef __AS_PARALLEL
+#define __AS_PARALLEL
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+class __as_range_pool {
+public:
+	// the number of threads used for `n` sources, 0 means one per core
+	static unsigned count(size_t n, unsigned threads) {
+		if (!threads) threads = std::max(1u, std::thread::hardware_concurrency());
+		return (unsigned) std::min<size_t>(threads, std::max<size_t>(n, 1));
+	}
+	/* calls `load(i, thread)` once for every `i` in [0, n), on `threads` threads. the first exception
+	 * thrown by `load` stops the threads from taking more indexes, and is rethrown once all of them are done */
+	static void run(size_t n, unsigned threads, const std::function<void(size_t, unsigned)>& load) {
+		std::unique_ptr<range[]> ranges(new range[threads]);
+		for (unsigned t = 0; t < threads; t++) {
+			ranges[t].begin = n * t / threads;
+			ranges[t].end = n * (t + 1) / threads;
+		}
+		std::atomic<bool> stop(false);
+		std::mutex error_lock;
+		std::exception_ptr error;
+		auto work = [&](unsigned t) {
+			try {
+				size_t i;
+				while (!stop && (ranges[t].pop(i) || steal(ranges.get(), threads, t, i))) load(i, t);
+			} catch (...) {
+				std::lock_guard<std::mutex> g(error_lock);
+				if (!error) error = std::current_exception();
+				stop = true;
+			}
+		};
+		std::vector<std::thread> pool;
+		for (unsigned t = 1; t < threads; t++) {
+			try {
+				pool.emplace_back(work, t);
+			} catch (const std::system_error&) {
+				break; // the ranges of the missing threads are stolen by the others
+			}
+		}
+		work(0);
+		for (std::thread& th : pool) th.join();
+		if (error) std::rethrow_exception(error);
+	}
+private:
+	struct range {
+		std::mutex lock;
+		size_t begin = 0, end = 0;
+		bool pop(size_t& i) {
+			std::lock_guard<std::mutex> g(lock);
+			if (begin == end) return false;
+			i = begin++;
+			return true;
+		}
+	};
+	// moves the second half of the largest range to the range of `t`, and pops its first index
+	static bool steal(range* ranges, unsigned threads, unsigned t, size_t& i) {
+		while (true) {
+			unsigned victim = threads;
+			size_t largest = 0;
+			for (unsigned v = 0; v < threads; v++) {
+				std::lock_guard<std::mutex> g(ranges[v].lock);
+				if (ranges[v].end - ranges[v].begin > largest) { largest = ranges[v].end - ranges[v].begin; victim = v; }
+			}
+			if (victim == threads) return false;
+			size_t begin, end;
+			{
+				std::lock_guard<std::mutex> g(ranges[victim].lock);
+				if (ranges[victim].begin == ranges[victim].end) continue; // emptied meanwhile
+				end = ranges[victim].end;
+				begin = ranges[victim].end -= (ranges[victim].end - ranges[victim].begin + 1) / 2;
+			}
+			std::lock_guard<std::mutex> g(ranges[t].lock);
+			ranges[t].begin = begin + 1;
+			ranges[t].end = end;
+			i = begin;
+			return true;
+		}
+	}
+};
+
+// deserializes `sources[i]` into `out[i]`, returns how many were loaded. errors are reported one at a time,
+// and an exception thrown while reading (e.g. `bad_alloc`) stops the loading and is rethrown to the caller
+template<typename T, typename S>
+size_t __as_deserialize_many(const std::vector<S>& sources, T* out,
+		const std::function<bool(size_t, std::string)>& error_callback, unsigned threads) {
+	std::mutex error_lock;
+	std::atomic<size_t> loaded(0);
+	threads = __as_range_pool::count(sources.size(), threads);
+	std::unique_ptr<__as_context[]> contexts(new __as_context[threads]); // one per thread
+	__as_range_pool::run(sources.size(), threads, [&](size_t i, unsigned t) {
+		const std::function<bool(std::string)> error = [&](const std::string& err) {
+			std::lock_guard<std::mutex> g(error_lock);
+			return error_callback(i, err);
+		};
+		bool ok;
+		if constexpr (std::is_same_v<S, std::string_view>) {
+			__as_membuf buf(sources[i].data(), sources[i].size());
+			std::istream in(&buf);
+			ok = out[i].deserialize_from(in, error, contexts[t]);
+		} else {
+			std::ifstream in(sources[i], std::ios::binary);
+			ok = in ? out[i].deserialize_from(in, error, contexts[t]) : (error("can't open " + sources[i]), false);
+		}
+		if (ok) loaded++;
+	});
+	return loaded;
+}
+#endif
+)__AS";
+
+// the files of record logs and lazy sources
+static const char* mapped_file_code = R"__AS(
+#ifndef __AS_MAPPED_FILE
+#define __AS_MAPPED_FILE
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define __AS_MMAP
+#endif
+
+// read-only memory mapping of a whole file; without mmap, the file is read into memory
+class __as_mapped_file {
+public:
+	__as_mapped_file() {}
+	__as_mapped_file(const __as_mapped_file&) = delete;
+	__as_mapped_file& operator=(const __as_mapped_file&) = delete;
+	~__as_mapped_file() { close(); }
+	bool open(const std::string& path) {
+		close();
+#ifdef __AS_MMAP
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		bool ok = fstat(fd, &st) == 0;
+		if (ok && st.st_size > 0) {
+			void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			if (m == MAP_FAILED) ok = false;
+			else { data_ = (const char*) m; size_ = st.st_size; }
+		}
+		::close(fd);
+		return ok;
+#else
+		std::ifstream in(path, std::ios::binary);
+		if (!in) return false;
+		copy_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		if (in.bad()) { copy_.clear(); return false; }
+		data_ = copy_.data();
+		size_ = copy_.size();
+		return true;
+#endif
+	}
+	void close() {
+#ifdef __AS_MMAP
+		if (data_) munmap((void*) data_, size_);
+#else
+		std::string().swap(copy_);
+#endif
+		data_ = nullptr; size_ = 0;
+	}
+	const char* data() const { return data_; }
+	uint64_t size() const { return size_; }
+private:
+	const char* data_ = nullptr;
+	uint64_t size_ = 0;
+#ifndef __AS_MMAP
+	std::string copy_;
+#endif
+};
+#endif
+)__AS";
+
+/* append-only record log, made of:
+ * - a header: magic, index interval, start of the last two indexes (updated in place)
+ * - record frames: tag, payload size, payload (as written by `serialize_to`)
+ * - an index frame every `interval` records: tag, count, offsets of the records,
+ *   followed by a trailer: start of this index, start of the previous one, records so far, tag
+ * every index but the last covers exactly `interval` records, so record N is found in O(1).
+ * a crash can leave a truncated frame at the end of the file, which is detected and ignored */
+static const char* record_log_code = R"__AS(
+#ifndef __AS_RECORD_LOG
+#define __AS_RECORD_LOG
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+struct __as_record_log_layout {
+	static constexpr char magic[8] = { 'A', 'S', 'R', 'L', 'O', 'G', '0', '1' };
+	static constexpr uint64_t index_slots = sizeof(magic) + sizeof(uint32_t); // the last index, then the previous one
+	static constexpr uint64_t header_size = index_slots + 2 * sizeof(uint64_t);
+	static constexpr uint32_t record_tag = 0x44524352, index_tag = 0x58444e49, index_end_tag = 0x444e4558;
+	static constexpr uint64_t record_header_size = sizeof(uint32_t) + sizeof(uint64_t);
+	static constexpr uint64_t index_trailer_size = 3 * sizeof(uint64_t) + sizeof(uint32_t);
+	static constexpr uint64_t index_min_size = sizeof(uint32_t) + sizeof(uint64_t) + index_trailer_size;
+
+	uint32_t interval = 0;
+	std::vector<uint64_t> indexes; // start of every index, in order
+	std::vector<uint64_t> tail; // records written after the last index
+	uint64_t indexed = 0; // records covered by the indexes
+	uint64_t valid_end = 0; // end of the last complete frame
+	bool truncated = false; // some bytes after `valid_end` were ignored
+
+	template<typename V> static V get(const char* d, uint64_t pos) {
+		V v; memcpy(&v, d + pos, sizeof(V)); return v;
+	}
+	static uint64_t index_end(const char* d, uint64_t start) {
+		return start + sizeof(uint32_t) + sizeof(uint64_t) + 8 * get<uint64_t>(d, start + 4) + index_trailer_size;
+	}
+	// returns the start of the index ending at `end`, or 0 if there is not a valid one
+	static uint64_t index_ending_at(const char* d, uint64_t end) {
+		if (end < header_size + index_min_size) return 0;
+		uint64_t t = end - index_trailer_size;
+		uint64_t start = get<uint64_t>(d, t), prev = get<uint64_t>(d, t + 8);
+		if (get<uint32_t>(d, t + 24) != index_end_tag) return 0;
+		if (start < header_size || start > end - index_min_size || prev >= start) return 0;
+		if (get<uint32_t>(d, start) != index_tag) return 0;
+		if ((end - start - index_min_size) / 8 < get<uint64_t>(d, start + 4)) return 0;
+		return index_end(d, start) == end ? start : 0;
+	}
+	// returns the end of the complete index starting at `start`, or 0 if there is not a valid one
+	static uint64_t index_at(const char* d, uint64_t size, uint64_t start) {
+		if (start < header_size || start > size || size - start < index_min_size || get<uint32_t>(d, start) != index_tag) return 0;
+		if ((size - start - index_min_size) / 8 < get<uint64_t>(d, start + 4)) return 0;
+		const uint64_t end = index_end(d, start);
+		return index_ending_at(d, end) == start ? end : 0;
+	}
+
+	// returns false if the data is not a record log
+	bool parse(const char* d, uint64_t size) {
+		*this = __as_record_log_layout();
+		if (size < header_size || memcmp(d, magic, sizeof(magic)) != 0) return false;
+		interval = get<uint32_t>(d, sizeof(magic));
+		if (interval == 0) return false;
+		/* the frames are followed from the last index in the header. a crash can leave newer indexes,
+		 * not in the header yet, or cut the last one: then the frames are followed from the previous one */
+		uint64_t last = 0, pos = header_size;
+		for (uint64_t slot = index_slots; slot < header_size; slot += sizeof(uint64_t)) {
+			const uint64_t start = get<uint64_t>(d, slot);
+			if (uint64_t end = start ? index_at(d, size, start) : 0) { last = start; pos = end; break; }
+		}
+		while (size - pos >= sizeof(uint32_t)) {
+			const uint32_t tag = get<uint32_t>(d, pos);
+			if (tag == record_tag && size - pos >= record_header_size
+					&& size - pos - record_header_size >= get<uint64_t>(d, pos + 4)) {
+				tail.push_back(pos);
+				pos += record_header_size + get<uint64_t>(d, pos + 4);
+			} else if (uint64_t end = tag == index_tag ? index_at(d, size, pos) : 0) {
+				last = pos; // its records were in the tail
+				tail.clear();
+				pos = end;
+			} else {
+				break;
+			}
+		}
+		if (last) {
+			indexed = get<uint64_t>(d, index_end(d, last) - index_trailer_size + 16);
+			// every index points to the previous one, which must end before it
+			for (uint64_t i = last; i; ) {
+				if (get<uint32_t>(d, i) != index_tag) return false;
+				indexes.push_back(i);
+				const uint64_t prev = get<uint64_t>(d, index_end(d, i) - index_trailer_size + 8);
+				if (prev && (prev < header_size || prev >= i || i - prev < index_min_size
+						|| (i - prev - index_min_size) / 8 < get<uint64_t>(d, prev + 4)
+						|| get<uint64_t>(d, index_end(d, prev) - index_trailer_size) != prev))
+					return false;
+				i = prev;
+			}
+			std::reverse(indexes.begin(), indexes.end());
+			// only the last index can be partial
+			for (size_t i = 0; i + 1 < indexes.size(); i++)
+				if (get<uint64_t>(d, indexes[i] + 4) != interval) return false;
+			if (get<uint64_t>(d, last + 4) > interval) return false;
+			if (indexed != (indexes.size() - 1) * (uint64_t) interval + get<uint64_t>(d, last + 4)) return false;
+		}
+		valid_end = pos;
+		truncated = pos != size;
+		return true;
+	}
+	uint64_t count() const { return indexed + tail.size(); }
+	uint64_t offset_of(const char* d, uint64_t n) const {
+		if (n >= indexed) return tail[n - indexed];
+		return get<uint64_t>(d, indexes[n / interval] + 12 + 8 * (n % interval));
+	}
+};
+
+template<typename T>
+class __as_record_log_writer {
+public:
+	__as_record_log_writer() {}
+	explicit __as_record_log_writer(const std::string& path, uint32_t index_interval = 1024) { open(path, index_interval); }
+	~__as_record_log_writer() { close(); }
+
+	/* opens a log for appending, creating it if needed; a truncated tail is dropped.
+	 * the index interval of existing logs is kept */
+	bool open(const std::string& path, uint32_t index_interval = 1024) {
+		close();
+		using L = __as_record_log_layout;
+		L layout;
+		uint64_t keep = 0;
+		size_t whole = 0; // records indexed now, by whole indexes
+		{
+			__as_mapped_file f;
+			if (f.open(path) && f.size() > 0) {
+				const char* d = f.data();
+				if (!layout.parse(d, f.size())) return false;
+				keep = layout.valid_end;
+				std::vector<uint64_t>& indexes = layout.indexes;
+				// a partial last index is removed and written again later, with its records
+				if (!indexes.empty() && L::get<uint64_t>(d, indexes.back() + 4) < layout.interval) {
+					uint64_t n = L::get<uint64_t>(d, indexes.back() + 4);
+					for (uint64_t i = 0; i < n; i++)
+						pending_.push_back(L::get<uint64_t>(d, indexes.back() + 12 + 8 * i));
+					layout.indexed -= n;
+					keep = indexes.back();
+					indexes.pop_back();
+				}
+				last_index_ = indexes.empty() ? 0 : indexes.back();
+				prev_index_ = indexes.size() < 2 ? 0 : indexes[indexes.size() - 2];
+				pending_.insert(pending_.end(), layout.tail.begin(), layout.tail.end());
+				/* e.g. after a crash while writing an index, the records can fill whole indexes, which are
+				 * written now. records cut off with the removed index, or left before the indexes written
+				 * now without being in them, are written again (after the indexes, for the latter) */
+				whole = pending_.size() / layout.interval * layout.interval;
+				for (size_t i = 0; i < pending_.size(); i++) {
+					if (pending_[i] < keep && (!whole || i < whole)) continue;
+					moved_.append(d + pending_[i], L::record_header_size + L::get<uint64_t>(d, pending_[i] + 4));
+					pending_[i] = moved;
+				}
+			}
+		}
+		if (layout.interval) {
+			// the header must not point to a removed index
+			end_ = keep;
+			out_.open(path, std::ios::binary | std::ios::in | std::ios::out);
+			put_index_slots();
+			out_.close();
+			if (out_.fail()) return false;
+			std::error_code ec;
+			std::filesystem::resize_file(path, keep, ec);
+			if (ec) return false;
+			interval_ = layout.interval;
+			total_ = layout.indexed + pending_.size();
+			out_.open(path, std::ios::binary | std::ios::in | std::ios::out);
+			out_.seekp(end_);
+			size_t from = 0; // the next record in `moved_`
+			for (size_t i = 0; i < whole; i++)
+				if (pending_[i] == moved) rewrite(pending_[i], from);
+			while (pending_.size() >= interval_) write_index();
+			for (uint64_t& r : pending_)
+				if (r == moved) rewrite(r, from);
+			moved_.clear();
+		} else {
+			if (index_interval == 0) return false;
+			interval_ = index_interval;
+			out_.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+			out_.write(L::magic, sizeof(L::magic));
+			put(interval_);
+			put(last_index_);
+			put(prev_index_);
+			end_ = L::header_size;
+		}
+		return out_.good();
+	}
+
+	bool append(const T& v) {
+		buffer_.clear();
+		v.serialize_to(stream_, context_);
+		const std::string_view payload = buffer_.view();
+		pending_.push_back(end_);
+		put(__as_record_log_layout::record_tag);
+		put((uint64_t) payload.size());
+		out_.write(payload.data(), payload.size());
+		end_ += __as_record_log_layout::record_header_size + payload.size();
+		total_++;
+		if (pending_.size() >= interval_) write_index();
+		return out_.good();
+	}
+
+	size_t size() const { return total_; }
+	bool good() const { return out_.good(); }
+	void flush() { out_.flush(); }
+
+	// indexes the remaining records, so that the log can be opened without scanning
+	void close() {
+		if (!out_.is_open()) return;
+		if (!pending_.empty()) write_index();
+		out_.close();
+		pending_.clear();
+		total_ = end_ = last_index_ = prev_index_ = 0;
+	}
+
+private:
+	std::ofstream out_;
+	// reused by every record
+	__as_growing_membuf buffer_;
+	std::ostream stream_ { &buffer_ };
+	__as_context context_;
+	std::string moved_; // records written again when opening
+	static constexpr uint64_t moved = ~0ull; // a pending record in `moved_`
+	std::vector<uint64_t> pending_; // records not yet indexed
+	uint64_t end_ = 0, last_index_ = 0, prev_index_ = 0, total_ = 0;
+	uint32_t interval_ = 0;
+
+	template<typename V> void put(V v) { out_.write((const char*) &v, sizeof(V)); }
+	/* updates the last indexes in the header, so that opening the log doesn't scan it.
+	 * seeking writes the buffered frames first, so the header never points past them */
+	void put_index_slots() {
+		out_.seekp(__as_record_log_layout::index_slots);
+		put(last_index_);
+		put(prev_index_);
+		out_.seekp(end_);
+	}
+	// appends the record at `from` in `moved_`, and sets its offset
+	void rewrite(uint64_t& offset, size_t& from) {
+		const uint64_t len = __as_record_log_layout::record_header_size
+			+ __as_record_log_layout::get<uint64_t>(moved_.data(), from + 4);
+		out_.write(moved_.data() + from, len);
+		offset = end_;
+		end_ += len;
+		from += len;
+	}
+	// indexes the first pending records, up to the interval
+	void write_index() {
+		const uint64_t start = end_, n = std::min<uint64_t>(pending_.size(), interval_);
+		put(__as_record_log_layout::index_tag);
+		put(n);
+		out_.write((const char*) pending_.data(), n * sizeof(uint64_t));
+		put(start);
+		put(last_index_);
+		put(total_ - (pending_.size() - n)); // the records indexed so far
+		put(__as_record_log_layout::index_end_tag);
+		end_ = start + __as_record_log_layout::index_min_size + 8 * n;
+		prev_index_ = last_index_;
+		last_index_ = start;
+		pending_.erase(pending_.begin(), pending_.begin() + n);
+		put_index_slots();
+	}
+};
+
+template<typename T>
+class __as_record_log_reader {
+public:
+	__as_record_log_reader() {}
+	explicit __as_record_log_reader(const std::string& path) { open(path); }
+
+	// maps the log in memory, only reading its indexes; returns false if it is not a record log
+	bool open(const std::string& path) {
+		if (!file_.open(path)) return false;
+		return layout_.parse(file_.data(), file_.size());
+	}
+	void close() { file_.close(); layout_ = __as_record_log_layout(); }
+
+	size_t size() const { return layout_.count(); }
+	// true when a truncated tail (from an interrupted write) was ignored
+	bool truncated() const { return layout_.truncated; }
+
+	// the bytes of the n-th record, as written by `serialize_to`
+	bool record(size_t n, const char*& data, size_t& size) const {
+		if (n >= layout_.count()) return false;
+		using L = __as_record_log_layout;
+		const char* d = file_.data();
+		uint64_t pos = layout_.offset_of(d, n);
+		if (pos + L::record_header_size > file_.size() || L::get<uint32_t>(d, pos) != L::record_tag) return false;
+		uint64_t len = L::get<uint64_t>(d, pos + 4);
+		if (len > file_.size() - pos - L::record_header_size) return false;
+		data = d + pos + L::record_header_size;
+		size = len;
+		return true;
+	}
+
+	bool read(size_t n, T& v, std::function<bool(std::string)> error_callback) const {
+		__as_context context;
+		return read(n, v, error_callback, context);
+	}
+	bool read(size_t n, T& v, const std::function<bool(std::string)>& error_callback, __as_context& context) const {
+		const char* data; size_t size;
+		if (!record(n, data, size)) {
+			error_callback("record log: can't find record " + std::to_string(n));
+			return false;
+		}
+		__as_membuf buf(data, size);
+		std::istream is(&buf);
+		return v.deserialize_from(is, error_callback, context);
+	}
+
+	// reads the records in [first, last), calling f(index, value) for each one
+	template<typename F>
+	bool read_range(size_t first, size_t last, F&& f, std::function<bool(std::string)> error_callback) const {
+		__as_context context;
+		for (size_t n = first; n < last; n++) {
+			T v;
+			if (!read(n, v, error_callback, context)) return false;
+			f(n, v);
+		}
+		return true;
+	}
+
+private:
+	__as_mapped_file file_;
+	__as_record_log_layout layout_;
+};
+#endif
+)__AS";
+
+/* framed output: a magic string, then blocks of `[length][crc][payload]`, ended by an empty block.
+ * lengths and crcs are raw 32 bit integers, and the CRC32C of every block covers its length and payload.
+ * the reader checks every block (in parallel) before reading anything, and reports the first corrupt one */
+static const char* framed_code = R"__AS(
+#ifndef __AS_FRAMED
+#define __AS_FRAMED
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define __AS_CRC_HW
+#endif
+// software CRC32C, 8 bytes at a time (slicing-by-8)
+inline uint32_t __as_crc32c_sw(uint32_t crc, const char* p, size_t n) {
+	struct tables {
+		uint32_t t[8][256];
+		tables() {
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++) c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+				t[0][i] = c;
+			}
+			for (int k = 1; k < 8; k++)
+				for (uint32_t i = 0; i < 256; i++)
+					t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+		}
+	};
+	static const tables tb;
+	const auto& t = tb.t;
+	for (; n >= 8; p += 8, n -= 8) {
+		uint32_t a, b;
+		memcpy(&a, p, 4);
+		memcpy(&b, p + 4, 4);
+		a ^= crc;
+		crc = t[7][a & 0xff] ^ t[6][(a >> 8) & 0xff] ^ t[5][(a >> 16) & 0xff] ^ t[4][a >> 24]
+			^ t[3][b & 0xff] ^ t[2][(b >> 8) & 0xff] ^ t[1][(b >> 16) & 0xff] ^ t[0][b >> 24];
+	}
+	for (; n; p++, n--) crc = t[0][(crc ^ (uint8_t) *p) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+#ifdef __AS_CRC_HW
+// SSE4.2 CRC32C, used when the CPU supports it
+__attribute__((target("sse4.2"))) inline uint32_t __as_crc32c_hw(uint32_t crc, const char* p, size_t n) {
+#ifdef __x86_64__
+	uint64_t c = crc;
+	for (; n >= 8; p += 8, n -= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		c = _mm_crc32_u64(c, v);
+	}
+	crc = (uint32_t) c;
+#endif
+	for (; n >= 4; p += 4, n -= 4) {
+		uint32_t v;
+		memcpy(&v, p, 4);
+		crc = _mm_crc32_u32(crc, v);
+	}
+	for (; n; p++, n--) crc = _mm_crc32_u8(crc, (uint8_t) *p);
+	return crc;
+}
+#endif
+// CRC32C of `n` bytes, continuing from `crc`
+inline uint32_t __as_crc32c(const char* p, size_t n, uint32_t crc = 0) {
+#ifdef __AS_CRC_HW
+	static const bool hw = __builtin_cpu_supports("sse4.2");
+	if (hw) return ~__as_crc32c_hw(~crc, p, n);
+#endif
+	return ~__as_crc32c_sw(~crc, p, n);
+}
+
+struct __as_framed {
+	static constexpr char magic[8] = { '#', 'A', 'S', 'C', 'R', 'C', '1', '\n' };
+	static constexpr size_t header = 8; // length and crc
+	static uint32_t block_crc(const char* block, uint32_t length) {
+		return __as_crc32c(block + header, length, __as_crc32c(block, 4));
+	}
+};
+
+// writes the bytes written to it in blocks, each with its crc
+class __as_framed_writer : public std::streambuf {
+public:
+	__as_framed_writer(std::ostream& out, size_t block_size)
+			: out_(out), buf_(__as_framed::header + std::min<size_t>(std::max<size_t>(block_size, 1), UINT32_MAX), '\0') {
+		out_.write(__as_framed::magic, sizeof(__as_framed::magic));
+		setp(&buf_[__as_framed::header], &buf_[0] + buf_.size());
+	}
+	// writes the last block, and the empty one
+	void finish() {
+		if (pptr() != pbase()) emit();
+		emit();
+	}
+protected:
+	int_type overflow(int_type c) override {
+		emit();
+		if (!traits_type::eq_int_type(c, traits_type::eof())) sputc(traits_type::to_char_type(c));
+		return traits_type::not_eof(c);
+	}
+private:
+	std::ostream& out_;
+	std::string buf_;
+	void emit() {
+		const uint32_t length = (uint32_t) (pptr() - pbase());
+		memcpy(&buf_[0], &length, 4);
+		const uint32_t crc = __as_framed::block_crc(&buf_[0], length);
+		memcpy(&buf_[4], &crc, 4);
+		out_.write(&buf_[0], __as_framed::header + length);
+		setp(&buf_[__as_framed::header], &buf_[0] + buf_.size());
+	}
+};
+
+// the payloads of checked blocks, read in place as a single stream
+class __as_framed_buf : public std::streambuf {
+public:
+	// checks every block, on `threads` threads, reporting the first corrupt one by its offset
+	bool open(std::string_view data, const __as_error_callback& e, unsigned threads) {
+		blocks_.clear();
+		starts_.clear();
+		size_t pos = sizeof(__as_framed::magic), total = 0;
+		std::string broken; // the structure of the blocks is broken from here
+		if (data.size() < pos || memcmp(data.data(), __as_framed::magic, pos))
+			return !e("framed input: missing header");
+		while (true) {
+			if (data.size() - pos < __as_framed::header) { broken = "framed input: truncated at offset " + std::to_string(pos); break; }
+			uint32_t length;
+			memcpy(&length, data.data() + pos, 4);
+			if (data.size() - pos - __as_framed::header < length) { broken = "framed input: corrupt block at offset " + std::to_string(pos); break; }
+			blocks_.push_back(data.data() + pos);
+			starts_.push_back(total);
+			total += length;
+			pos += __as_framed::header + length;
+			if (!length) break; // the last block
+		}
+		const size_t n = blocks_.size();
+		std::unique_ptr<bool[]> ok(new bool[n]);
+		__as_range_pool::run(n, __as_range_pool::count(n, threads), [&](size_t i, unsigned) {
+			uint32_t length, crc;
+			memcpy(&length, blocks_[i], 4);
+			memcpy(&crc, blocks_[i] + 4, 4);
+			ok[i] = __as_framed::block_crc(blocks_[i], length) == crc;
+		});
+		for (size_t i = 0; i < n; i++)
+			if (!ok[i]) { e("framed input: corrupt block at offset " + std::to_string(blocks_[i] - data.data())); return false; }
+		if (!broken.empty()) { e(broken); return false; }
+		starts_.push_back(total); // the end
+		seekpos(0, std::ios_base::in);
+		return true;
+	}
+protected:
+	int_type underflow() override {
+		while (gptr() == egptr()) {
+			if (current_ + 1 >= blocks_.size()) return traits_type::eof();
+			set(current_ + 1, starts_[current_ + 1]);
+		}
+		return traits_type::to_int_type(*gptr());
+	}
+	// tellg and seekg are used to peek at polymorphic types
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+		const off_type base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? off_type(starts_[current_] + (gptr() - eback())) : off_type(starts_.back());
+		return seekpos(pos_type(base + off), which);
+	}
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+		if (!(which & std::ios_base::in) || off_type(pos) < 0 || size_t(off_type(pos)) > starts_.back()) return pos_type(off_type(-1));
+		const size_t p = size_t(off_type(pos));
+		// the last block starting at or before `p`
+		set(std::upper_bound(starts_.begin(), starts_.end() - 1, p) - starts_.begin() - 1, p);
+		return pos;
+	}
+private:
+	std::vector<const char*> blocks_;
+	std::vector<size_t> starts_; // offset of every payload in the stream, then its length
+	size_t current_ = 0;
+	void set(size_t block, size_t pos) {
+		current_ = block;
+		char* b = const_cast<char*>(blocks_[block]) + __as_framed::header;
+		const size_t length = starts_[block + 1] - starts_[block];
+		setg(b, b + (pos - starts_[block]), b + length);
+	}
+};
+#endif
+)__AS";
+
+/* lazy loading of pointed values. `serialize_indexed_to` ends the output with an index:
+ * "#index <count> ", the offset of every pointed value (by id) as raw 64 bit integers,
+ * the offset of the index and a magic string. a source maps the whole output, reads the root
+ * object without following `@lazy` fields, and reads the values they point to on first access.
+ * other pointers are followed through the index too, and every value is read once (and cached) */
+static const char* lazy_code = R"__AS(
+#ifndef __AS_LAZY
+#define __AS_LAZY
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+struct __as_lazy_index {
+	static constexpr char magic[8] = { '#', 'A', 'S', 'L', 'A', 'Z', 'Y', '\n' };
+	// written after the pointed values, `offsets` are relative to the beginning of the output
+	static void write(std::ostream& s, uint64_t index_pos, const std::vector<uint64_t>& offsets) {
+		s << "#index " << offsets.size() << ' ';
+		s.write((const char*) offsets.data(), offsets.size() * sizeof(uint64_t));
+		s.write((const char*) &index_pos, sizeof(index_pos));
+		s.write(magic, sizeof(magic));
+	}
+};
+
+class __as_lazy_source : public std::enable_shared_from_this<__as_lazy_source> {
+public:
+	using fun_t = void* (*)(std::istream&, const __as_error_callback&, __deserialization_state&);
+
+	// maps a file written by `serialize_indexed_to`, returns nullptr if it can't be used (see `lazy_file_code`)
+	static inline std::shared_ptr<__as_lazy_source> open(const std::string& path, __as_error_callback error_callback);
+	// the same, for a copy of an output in memory
+	static std::shared_ptr<__as_lazy_source> from_memory(std::string data, __as_error_callback error_callback) {
+		std::shared_ptr<__as_lazy_source> s(new __as_lazy_source(std::move(error_callback)));
+		s->memory_ = std::move(data);
+		return s->parse(s->memory_.data(), s->memory_.size()) ? s : nullptr;
+	}
+
+	// reads the root object, without reading the values pointed by its `@lazy` fields
+	template<typename T>
+	bool read(T& v) {
+		std::lock_guard<std::recursive_mutex> g(lock_);
+		__as_membuf buf(data_, index_pos_);
+		std::istream s(&buf);
+		__deserialization_state pm;
+		pm.lazy = this;
+		pm.owners = &owners_;
+		failed_ = false;
+		return v._deserialize_from(s, report_, pm) && resolve(pm) && !failed_;
+	}
+	// reads (once) the value with id `id`, using `fun`
+	void* load(size_t id, fun_t fun) {
+		std::lock_guard<std::recursive_mutex> g(lock_);
+		__deserialization_state pm;
+		pm.lazy = this;
+		pm.owners = &owners_;
+		failed_ = false;
+		void* v = read_value(id, fun, pm);
+		return v && resolve(pm) && !failed_ ? v : nullptr;
+	}
+	size_t size() const { return count_; }
+	// how many values were read
+	size_t loaded() {
+		std::lock_guard<std::recursive_mutex> g(lock_);
+		return cache_.size();
+	}
+
+private:
+	std::shared_ptr<const void> file_; // the mapped file, if opened from a file
+	std::string memory_;
+	const char* data_ = nullptr;
+	uint64_t index_pos_ = 0, count_ = 0;
+	const char* offsets_ = nullptr;
+	__as_error_callback error_;
+	__as_error_callback report_; // calls `error_`, and remembers that the current read failed
+	bool failed_ = false;
+	std::recursive_mutex lock_; // loading a value can load others
+	std::unordered_map<size_t, void*> cache_;
+	std::unordered_map<size_t, std::shared_ptr<void>> owners_; // values shared by the loads, owned once
+
+	explicit __as_lazy_source(__as_error_callback e) : error_(std::move(e)) {
+		report_ = [this](std::string err) {
+			failed_ = true;
+			return error_(std::move(err));
+		};
+	}
+
+	bool parse(const char* d, uint64_t size) {
+		data_ = d;
+		const uint64_t trailer = sizeof(uint64_t) + sizeof(__as_lazy_index::magic);
+		if (size < trailer || memcmp(d + size - sizeof(__as_lazy_index::magic), __as_lazy_index::magic, sizeof(__as_lazy_index::magic)))
+			return !error_("lazy source: no index, the output was not written by serialize_indexed_to");
+		memcpy(&index_pos_, d + size - trailer, sizeof(uint64_t));
+		const char* p = d + index_pos_;
+		const char* end = d + size - trailer;
+		const char header[] = "#index ";
+		if (index_pos_ >= size || (uint64_t) (end - p) < sizeof(header) - 1 || memcmp(p, header, sizeof(header) - 1))
+			return !error_("lazy source: corrupted index");
+		p += sizeof(header) - 1;
+		for (; p < end && *p >= '0' && *p <= '9'; p++) count_ = count_ * 10 + (*p - '0');
+		offsets_ = p + 1;
+		if (p >= end || (uint64_t) (end - offsets_) != count_ * sizeof(uint64_t))
+			return !error_("lazy source: corrupted index");
+		return true;
+	}
+	void* read_value(size_t id, fun_t fun, __deserialization_state& pm) {
+		auto it = cache_.find(id);
+		if (it != cache_.end()) return it->second;
+		if (id == 0 || id > count_) { error_("lazy source: unknown pointer " + std::to_string(id)); return nullptr; }
+		uint64_t offset;
+		memcpy(&offset, offsets_ + (id - 1) * sizeof(uint64_t), sizeof(uint64_t));
+		if (offset >= index_pos_) { error_("lazy source: corrupted index"); return nullptr; }
+		__as_membuf buf(data_ + offset, index_pos_ - offset);
+		std::istream s(&buf);
+		size_t k; s >> k;
+		if (k != id) { error_("lazy source: expected the definition of " + std::to_string(id)); return nullptr; }
+		pm.strings.clear(); // `@dict` strings are numbered in each value
+		void* v = fun(s, report_, pm);
+		if (!v || failed_) return nullptr; // values read with errors are not cached
+		cache_[id] = v;
+		return v;
+	}
+	// reads the values referenced by (non lazy) pointers, which can reference others
+	bool resolve(__deserialization_state& pm) {
+		for (size_t n = 0; n < pm.ptrs.size(); n++) {
+			if (pm.ptrs.value_at(n).value) continue;
+			void* v = read_value(pm.ptrs.key_at(n), pm.ptrs.value_at(n).fun, pm);
+			if (!v) return false;
+			pm.ptrs.value_at(n).value = v;
+		}
+		pm.missing = 0;
+		return pm.fill_refs(report_);
+	}
+};
+
+// pointer read on first access from a lazy source, or set as usual. not thread safe, as raw pointers
+template<typename T>
+class __as_lazy {
+public:
+	__as_lazy(T* p = nullptr) : ptr_(p) {}
+	__as_lazy& operator=(T* p) {
+		ptr_ = p;
+		source_.reset();
+		return *this;
+	}
+	T* get() const {
+		if (source_) {
+			ptr_ = (T*) source_->load(id_, fun_);
+			source_.reset();
+		}
+		return ptr_;
+	}
+	T& operator*() const { return *get(); }
+	T* operator->() const { return get(); }
+	explicit operator bool() const { return source_ || ptr_; }
+	bool loaded() const { return !source_; }
+
+	// used by the generated code
+	void _set_lazy(std::shared_ptr<__as_lazy_source> source, size_t id, __as_lazy_source::fun_t fun) {
+		source_ = std::move(source);
+		id_ = id;
+		fun_ = fun;
+		ptr_ = nullptr;
+	}
+	T*& _ptr() { return ptr_; }
+private:
+	mutable T* ptr_;
+	mutable std::shared_ptr<__as_lazy_source> source_;
+	size_t id_ = 0;
+	__as_lazy_source::fun_t fun_ = nullptr;
+};
+#endif
+)__AS";
+
+/* coroutine-based serializer: it writes into a bounded buffer and suspends when it is full,
+ * at field, element and pointed value boundaries, and inside long strings and raw blocks.
+ * the caller drains the buffer (e.g. when a socket is writable) and resumes it.
+ * only available with C++20 coroutines */
+static const char* async_code = R"__AS(
+#if !defined(__AS_ASYNC) && defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define __AS_ASYNC
+#include <algorithm>
+#include <climits>
+#include <coroutine>
+#include <cstring>
+#include <exception>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// lazily started coroutine, which resumes its caller when done
+class __as_task {
+public:
+	struct promise_type {
+		std::coroutine_handle<> continuation = std::noop_coroutine();
+		std::exception_ptr exception;
+		__as_task get_return_object() { return __as_task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		struct final_awaiter {
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+				return h.promise().continuation;
+			}
+			void await_resume() noexcept {}
+		};
+		final_awaiter final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { exception = std::current_exception(); }
+	};
+
+	explicit __as_task(std::coroutine_handle<promise_type> h) : h_(h) {}
+	__as_task(__as_task&& o) : h_(std::exchange(o.h_, nullptr)) {}
+	__as_task& operator=(__as_task&&) = delete;
+	~__as_task() { if (h_) h_.destroy(); }
+
+	bool await_ready() { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+		h_.promise().continuation = caller;
+		return h_;
+	}
+	void await_resume() { rethrow(); }
+
+	std::coroutine_handle<promise_type> handle() const { return h_; }
+	void rethrow() const {
+		if (h_.promise().exception) std::rethrow_exception(h_.promise().exception);
+	}
+private:
+	std::coroutine_handle<promise_type> h_;
+};
+
+/* output buffer which suspends the serializer once it holds `capacity` bytes. the generated code
+ * writes long strings and raw blocks in pieces of `capacity` bytes, so the buffer holds at most
+ * about twice its capacity */
+class __as_async_buffer : private std::streambuf {
+public:
+	explicit __as_async_buffer(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)), data_(capacity_, '\0'), stream_(this) {
+		reset(0);
+	}
+	std::ostream& stream() { return stream_; }
+	size_t capacity() const { return capacity_; }
+	bool full() const { return used() - begin_ >= capacity_; }
+
+	// the bytes waiting to be sent
+	std::string_view pending() const { return std::string_view(pbase() + begin_, used() - begin_); }
+	// marks the first `n` pending bytes as sent, at most all of them
+	void consume(size_t n) {
+		begin_ += std::min(n, used() - begin_);
+		if (begin_ >= used() / 2) {
+			const size_t left = used() - begin_;
+			memmove(&data_[0], &data_[begin_], left);
+			begin_ = 0;
+			reset(left);
+		}
+	}
+
+	// awaited by the serializer, suspends it while the buffer is full
+	struct awaiter {
+		__as_async_buffer* b;
+		bool await_ready() const { return !b->full(); }
+		void await_suspend(std::coroutine_handle<> h) { b->waiting_ = h; }
+		void await_resume() {}
+	};
+	awaiter drained() { return { this }; }
+	// resumes the suspended serializer, or starts it; nothing happens until the buffer is drained
+	void resume(std::coroutine_handle<> start) {
+		if (waiting_ && full()) return;
+		std::coroutine_handle<> h = waiting_ ? std::exchange(waiting_, nullptr) : start;
+		h.resume();
+	}
+
+private:
+	size_t capacity_, begin_ = 0;
+	std::string data_; // the put area
+	std::ostream stream_;
+	std::coroutine_handle<> waiting_;
+
+	size_t used() const { return pptr() - pbase(); }
+	// the put area is the whole buffer, with `n` bytes already written
+	void reset(size_t n) {
+		setp(&data_[0], &data_[0] + data_.size());
+		for (; n > INT_MAX; n -= INT_MAX) pbump(INT_MAX); // pbump takes an int
+		pbump((int) n);
+	}
+	int_type overflow(int_type c) override {
+		const size_t n = used();
+		data_.resize(2 * data_.size());
+		reset(n);
+		if (!traits_type::eq_int_type(c, traits_type::eof())) sputc(traits_type::to_char_type(c));
+		return traits_type::not_eof(c);
+	}
+};
+
+// pointed values are written later by captureless coroutines, like in `__serialization_state`
+struct __as_async_state;
+struct __as_deferred_async {
+	const void* value;
+	__as_task (*write)(const void* value, __as_async_buffer& w, __as_async_state& pm);
+};
+struct __as_async_state : __as_pointer_graph<__as_deferred_async> {};
+
+template<typename T>
+class __as_async_serializer {
+public:
+	__as_async_serializer(const T& v, size_t capacity) : buffer_(capacity), task_(v.serialize_async_to(buffer_)) {}
+
+	// runs until the buffer is full or the serialization is done
+	void resume() {
+		if (done()) return;
+		buffer_.resume(task_.handle());
+		if (done()) task_.rethrow();
+	}
+	bool done() const { return task_.handle().done(); }
+	std::string_view pending() const { return buffer_.pending(); }
+	void consume(size_t n) { buffer_.consume(n); }
+
+private:
+	__as_async_buffer buffer_;
+	__as_task task_;
+};
+#endif
+)__AS";
+
+/* reading files, loading in parallel and checksums need system headers (e.g. for mmap and threads),
+ * so they are only compiled where `AS_RUNTIME_IO` is defined, like in the generated sources */
+static const char* lazy_file_code = R"__AS(
+#ifndef __AS_LAZY_FILE
+#define __AS_LAZY_FILE
+inline std::shared_ptr<__as_lazy_source> __as_lazy_source::open(const std::string& path, __as_error_callback error_callback) {
+	std::shared_ptr<__as_lazy_source> s(new __as_lazy_source(std::move(error_callback)));
+	auto file = std::make_shared<__as_mapped_file>();
+	if (!file->open(path)) { s->error_("lazy source: can't open " + path); return nullptr; }
+	s->file_ = file;
+	return s->parse(file->data(), file->size()) ? s : nullptr;
+}
+#endif
+)__AS";
+
+/* the runtime is written once, next to the generated headers, which include it. its version is a hash of
+ * its code: headers generated by different versions can't be compiled together, and fail to include each other */
+void emit_runtime(const string& header, ostream& hout) {
+	ostringstream core, io;
+	core << graph_code << size_code << footprint_code << bits_code << context_code << hash_code << membuf_code << lazy_code << async_code;
+	io << mapped_file_code << parallel_code << framed_code << record_log_code << lazy_file_code;
+	uint32_t version = 2166136261u; // FNV-1a
+	for (const string& code : { core.str(), io.str() })
+		for (unsigned char c : code) version = (version ^ c) * 16777619u;
+	char v[16];
+	snprintf(v, sizeof(v), "0x%08x", version);
+
+	ostringstream text;
+	text << "// support code of the headers generated by auto-serializer, included by all of them" << '\n'
+		<< "#if defined(__AS_RUNTIME) && __AS_RUNTIME != " << v << '\n'
+		<< "#error \"headers generated by different versions of auto-serializer can't be used together\"" << '\n'
+		<< "#endif" << '\n'
+		<< "#ifndef __AS_RUNTIME" << '\n'
+		<< "#define __AS_RUNTIME " << v << '\n'
+		<< core.str()
+		<< "#endif" << '\n'
+		// can be included again, once `AS_RUNTIME_IO` is defined
+		<< "#if defined(AS_RUNTIME_IO) && !defined(__AS_RUNTIME_IO)" << '\n'
+		<< "#define __AS_RUNTIME_IO" << '\n'
+		<< io.str()
+		<< "#endif" << '\n';
+
+	// generators running in parallel write the same file: it is replaced atomically, only when it changes
+	const size_t slash = header.find_last_of("/\\");
+	const string path = header.substr(0, slash == string::npos ? 0 : slash + 1) + runtime_header;
+	ifstream current(path, ios::binary);
+	if (!current || string(istreambuf_iterator<char>(current), istreambuf_iterator<char>()) != text.str()) {
+		const string tmp = header + ".runtime.tmp";
+		{
+			ofstream out(tmp, ios::binary);
+			out << text.str();
+			if (!out.flush()) throw runtime_error("can't write the runtime header: " + tmp);
+		}
+		if (rename(tmp.c_str(), path.c_str()) != 0) throw runtime_error("can't write the runtime header: " + path);
+	}
+
+	hout << "#include \"" << runtime_header << "\"" << '\n'
+		<< "#if __AS_RUNTIME != " << v << '\n'
+		<< "#error \"" << runtime_header << " was written by a different version of auto-serializer\"" << '\n'
+		<< "#endif" << '\n';
+}
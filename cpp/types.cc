@@ -1,6 +1,10 @@
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <functional>
+#include <cctype>
+#include <algorithm>
+#include <sstream>
 
 #include <types.hh>
 #include <node.hh>
@@ -11,32 +15,110 @@ using namespace std;
 #define DEREF_AS(new_type, ptr) (*((new_type*) (ptr)))
 
 using rw_function = function<void(const string&, const NType&, ostream&)>;
-struct rw_pair { rw_function read, write; };
-#define _P(name) rw_pair{r_##name, w_##name}
+// the length of every value of a type, when it doesn't depend on the value (e.g. `bool`)
+struct constant_length {
+	string value; // an expression, empty when the length depends on the value
+	string condition; // when set, a constant expression which must hold for `value` to be used (e.g. raw structs)
+};
+using rw_constant = function<constant_length(const NType&)>;
+struct rw_pair {
+	rw_function read, write;
+	rw_function size; // adds the length of the written value to `__pm.size`
+	rw_function heap; // adds the heap bytes owned by the value to `__pm.bytes`
+	bool native = false; // can be copied as raw memory
+	rw_constant constant; // unset when the length is never constant
+};
+#define _P(name) rw_pair{r_##name, w_##name, s_##name, h_##name}
+#define _PC(name) rw_pair{r_##name, w_##name, s_##name, h_##name, false, c_##name}
+#define _PN(name) rw_pair{r_##name, w_##name, s_##name, h_native, true, c_##name}
 
 extern rw_pair rw_object, rw_static_array; // declared down
 
+bool async_mode = false;
+// set while generating the code of `@dict` fields, whose strings are written once per value
+bool dict_mode = false;
+/* in column-wise code, fields are accessed through the current element `__el`,
+ * which is set for the lengths of pointers used as arrays by `in_element` */
+string element_scope;
+
 std::unordered_map<std::string, rw_pair> types_map;
 std::unordered_map<std::string, const NType*> alias_map;
+// structs with only native fields, see `raw_layout`: name -> layout id
+std::unordered_map<std::string, std::string> raw_structs;
+
+// the result of `find_type_pair` for each type, cleared whenever an alias is declared
+struct type_resolution { const NType* real; const rw_pair* pair; };
+std::unordered_map<const NType*, type_resolution> resolved_types;
 
 /* finds an appropriate `rw_pair` for the type `t`.
  * if the type is found to be an alias, it is replaced by the real type
  * to avoid losing generic types information (hence the reference to pointer) */
 const rw_pair& find_type_pair(const NType*& t) {
+	auto cached = resolved_types.find(t);
+	if (cached != resolved_types.end()) {
+		t = cached->second.real;
+		return *cached->second.pair;
+	}
+	const NType* orig = t;
+	const rw_pair* pair = nullptr;
 	// recursively resolve aliases
 	while (true) {
 		// arrays are saved like: int[`5`] --> []<int>
-		if (t->isArray) return rw_static_array;
+		if (t->isArray) { pair = &rw_static_array; break; }
 
 		auto itr = alias_map.find(t->name->value);
 		if (itr == alias_map.end()) break;
 		t = itr->second;
 	}
 
-	const string tname = t->name->value;
-	auto itr = types_map.find(tname);
-	if (itr == types_map.end()) return rw_object;
-	return itr->second;
+	if (!pair) {
+		auto itr = types_map.find(t->name->value);
+		pair = itr == types_map.end() ? &rw_object : &itr->second;
+	}
+	resolved_types[orig] = { t, pair };
+	return *pair;
+}
+
+bool is_raw_type(const NType*& t) {
+	const rw_pair& pair = find_type_pair(t);
+	if (&pair != &rw_static_array) return pair.native;
+	const NType* e_t = (*t->generics)[0];
+	return is_raw_type(e_t);
+}
+
+bool is_comparable_type(const NType* t) {
+	if (find_type_pair(t).native) return true;
+	if (t->isArray) return false; // static arrays can't be compared nor assigned
+	static const unordered_set<string> containers = { "string", "vector", "deque", "set", "unordered_set",
+		"map", "unordered_map", "array", "pair", "tuple", "optional", "dict" };
+	const string& name = t->name->value;
+	if (name == "packed") return is_comparable_type((*t->generics)[0]); // the other arguments are numbers
+	if (!containers.count(name.compare(0, 5, "std::") ? name : name.substr(5))) return false;
+	const GenericsList& list = *t->generics;
+	for (size_t i = 0; i < list.size(); i++)
+		if (!(i == 1 && name.find("array") != string::npos) && !is_comparable_type(list[i])) // the size of an array
+			return false;
+	return true;
+}
+
+void add_raw_struct(const string& name, const string& layout) {
+	raw_structs[name] = layout;
+}
+
+string raw_struct_size(const string& name, const string& layout) {
+	const size_t preface = name.size() + 3 + 5 + layout.size() + 1; // `<name> 1\n#raw <layout>/`
+	return to_string(preface) + " + __as_digits(sizeof(" + name + ")) + 1 + sizeof(" + name + ") + 1";
+}
+
+// the layout id of a struct with only native fields, or nullptr
+const string* raw_layout_of(const NType& t) {
+	auto itr = raw_structs.find(to_string(t));
+	return itr == raw_structs.end() ? nullptr : &itr->second;
+}
+
+// name and type of a field, written before its value
+string field_preface(const string& fname, const NType& t) {
+	return fname + " " + to_string(t) + " ";
 }
 
 void serialize_value(const std::string& fname, const NType& t, const rw_pair& pair, std::ostream& o) {
@@ -52,9 +134,56 @@ void serialize_field(const std::string& fname, const NType& orig_t, std::ostream
 	// find the pair immediately to reasolve aliases, and use only resolved names in the output file
 	const NType* real_t = &orig_t;
 	const rw_pair& pair = find_type_pair(real_t);
-	o << "\t__s << \"" << fname << " " << *real_t << " \";" << endl;
+	o << "\t__s << \"" << field_preface(fname, *real_t) << "\";" << '\n';
 	serialize_value(fname, *real_t, pair, o);
-	o << "\t__s << \"\\n\";" << endl;
+	o << "\t__s << \"\\n\";" << '\n';
+}
+
+void size_value(const std::string& fname, const NType& t, std::ostream& o) {
+	const NType* real_t = &t;
+	const rw_pair& pair = find_type_pair(real_t);
+	pair.size(fname, *real_t, o);
+}
+
+constant_length constant_size(const NType& t) {
+	const NType* real_t = &t;
+	const rw_pair& pair = find_type_pair(real_t);
+	return pair.constant ? pair.constant(*real_t) : constant_length{};
+}
+
+/* sizes values of type `t` at once when their length is constant: `add` makes the statement adding
+ * the constant length, and `each` generates the code sizing the values one by one, used when the
+ * length is constant only under a condition. returns false, generating nothing, when it is never constant */
+bool size_constant(const NType& t, ostream& o, const function<string(const string&)>& add, const function<void()>& each) {
+	const constant_length c = constant_size(t);
+	if (c.value.empty()) return false;
+	if (c.condition.empty()) {
+		o << "\t" << add(c.value) << '\n';
+		return true;
+	}
+	o << "\tif constexpr (" << c.condition << ") " << add(c.value) << '\n'
+		<< "\telse {" << '\n';
+	each();
+	o << "\t}" << '\n';
+	return true;
+}
+
+void size_field(const std::string& fname, const NType& orig_t, std::ostream& o) {
+	const NType* real_t = &orig_t;
+	const rw_pair& pair = find_type_pair(real_t);
+	o << "\t__pm.size += " << field_preface(fname, *real_t).size() + 1 << ";" << '\n';
+	pair.size(fname, *real_t, o);
+}
+
+void heap_value(const std::string& fname, const NType& t, std::ostream& o) {
+	const NType* real_t = &t;
+	const rw_pair& pair = find_type_pair(real_t);
+	pair.heap(fname, *real_t, o);
+}
+
+// values that own no heap memory, for which no code is generated (resolves aliases)
+bool owns_heap(const NType* t) {
+	return !is_raw_type(t);
 }
 
 void deserialize_value(const std::string& fname, const NType& t, const rw_pair& pair, std::ostream& o) {
@@ -70,172 +199,1314 @@ void deserialize_value(const std::string& fname, const NType& t, std::ostream& o
 void deserialize_field(const std::string& fname, const NType& orig_t, std::ostream& o) {
 	const NType* real_t = &orig_t;
 	const rw_pair& pair = find_type_pair(real_t);
-	o << "\t\t\t__TYPE_CHK(\"" << *real_t << "\");" << endl
-		<< "\t\t\tauto& " << fname << " = __v." << fname << ";" << endl;
+	o << "\t\t\t__TYPE_CHK(\"" << *real_t << "\");" << '\n'
+		<< "\t\t\tauto& " << fname << " = __v." << fname << ";" << '\n';
 	deserialize_value(fname, *real_t, pair, o);
 }
 
+// the length of every native value of `type`, if it is constant
+string native_constant(const string& type) {
+	return type == "bool" || type == "int8_t" || type == "uint8_t" ? "1" : ""; // chars are written as they are
+}
+
+// the length of a native value, as written by `operator<<`
+string native_size(const string& type, const string& value) {
+	const string constant = native_constant(type);
+	if (!constant.empty()) return constant;
+	if (type == "float" || type == "double") return "__as_float_size(" + value + ")";
+	return "__as_digits((" + type + ") " + value + ")";
+}
+
 #define _NATIVE_M(type) \
+	void s_##type(const string& fname, const NType&, ostream& o) { \
+		o << "\t__pm.size += " << native_size(#type, fname) << ";" << '\n'; \
+	} \
+	constant_length c_##type(const NType&) { \
+		return { native_constant(#type) }; \
+	} \
 	void w_##type(const string& fname, const NType&, ostream& o) { \
-		o << "\t__s << ((" << #type << ") " << fname << ");" << endl; \
+		o << "\t__s << ((" << #type << ") " << fname << ");" << '\n'; \
 	} \
 	void r_##type(const string& fname, const NType&, ostream& o) { \
-		o << "\t\t\t__s >> ((" << #type << "&) " << fname << ");" << endl; \
+		o << "\t\t\t__s >> ((" << #type << "&) " << fname << ");" << '\n'; \
 		o << "\t\t\tif (__s.fail()) if (__e(__AS_CTX \"." << fname \
 			/* this `return 0` is either a 0 or a nullptr, both mean a failure in different contextes */ \
-			<< ": expected a " << #type << ", but parsing failed\")) return 0;" << endl; \
+			<< ": expected a " << #type << ", but parsing failed\")) return 0;" << '\n'; \
 	}
 
+// native values own no heap memory
+void h_native(const string&, const NType&, ostream&) {}
+
 _NATIVE_M(bool)
 _NATIVE_M(int8_t) _NATIVE_M(int16_t) _NATIVE_M(int32_t) _NATIVE_M(int64_t)
 _NATIVE_M(uint8_t) _NATIVE_M(uint16_t) _NATIVE_M(uint32_t) _NATIVE_M(uint64_t)
 _NATIVE_M(float) _NATIVE_M(double)
 
+/* writes `size` bytes starting at `data`. the coroutine-based serializer writes them in pieces
+ * as large as its buffer, suspending between them, so that long values don't fill the memory */
+void write_block(const string& fname, const string& data, const string& size, ostream& o) {
+	if (!async_mode) {
+		o << "\t__s.write((const char*) " << data << ", " << size << ");" << '\n';
+		return;
+	}
+	const string at = "__bo_" + fname, n = "__bn_" + fname, k = "__bk_" + fname;
+	o << "\tfor (size_t " << at << " = 0, " << n << " = " << size << "; " << at << " < " << n << "; ) {" << '\n'
+		<< "\tconst size_t " << k << " = " << n << " - " << at << " < __w.capacity() ? " << n << " - " << at << " : __w.capacity();" << '\n'
+		<< "\t__s.write((const char*) " << data << " + " << at << ", " << k << ");" << '\n'
+		<< "\t" << at << " += " << k << ";" << '\n'
+		<< "\t__AS_YIELD;" << '\n'
+		<< "\t}" << '\n';
+}
+
+/* in `@dict` fields, strings already written in the same call are written as `=<number>`,
+ * numbered in the order they are first written. `str` is an expression evaluating to the string */
+void w_dict_string(const string& fname, const string& str, ostream& o) {
+	o << "\tif (size_t __ds_" << fname << "; __pm.dict_find(" << str << ", __ds_" << fname << ")) __s << '=' << __ds_" << fname << ";" << '\n';
+	if (!async_mode) {
+		o << "\telse __s << " << str << ".size() << ' ' << " << str << ";" << '\n';
+		return;
+	}
+	o << "\telse {" << '\n'
+		<< "\t__s << " << str << ".size() << ' ';" << '\n';
+	write_block(fname, str + ".data()", str + ".size()", o);
+	o << "\t}" << '\n';
+}
+
+void s_dict_string(const string& fname, const string& str, ostream& o) {
+	o << "\tif (size_t __ds_" << fname << "; __pm.dict_find(" << str << ", __ds_" << fname << ")) __pm.size += 1 + __as_digits(__ds_" << fname << ");" << '\n'
+		<< "\telse __pm.size += __as_digits(" << str << ".size()) + 1 + " << str << ".size();" << '\n';
+}
+
+// `target` is assigned the shared string read
+void r_dict_string(const string& fname, const string& target, ostream& o) {
+	o << "\t\t\tif (const shared_ptr<string>* __ds_" << fname << " = __pm.dict_read(__s)) " << target << ";" << '\n'
+		<< "\t\t\telse if (__e(__AS_CTX \"." << fname << ": invalid dictionary string\")) return 0;" << '\n';
+}
+
 void w_string(const string& fname, const NType&, ostream& o) {
-	o << "\t__s << " << fname << ".size() << ' ' << " << fname << ";" << endl;
+	if (dict_mode) return w_dict_string(fname, fname, o);
+	if (!async_mode) {
+		o << "\t__s << " << fname << ".size() << ' ' << " << fname << ";" << '\n';
+		return;
+	}
+	o << "\t__s << " << fname << ".size() << ' ';" << '\n';
+	write_block(fname, fname + ".data()", fname + ".size()", o);
+}
+
+void s_string(const string& fname, const NType&, ostream& o) {
+	if (dict_mode) return s_dict_string(fname, fname, o);
+	o << "\t__pm.size += __as_digits(" << fname << ".size()) + 1 + " << fname << ".size();" << '\n';
+}
+
+// inline strings (small string optimization) own no heap memory
+void h_string(const string& fname, const NType&, ostream& o) {
+	o << "\t__pm.bytes += __as_string_heap(" << fname << ");" << '\n';
 }
 
 void r_string(const string& fname, const NType&, ostream& o) {
-	o << "\t\t\tsize_t __" << fname << "_sz; ; __s >> __" << fname << "_sz;" << endl
-		<< "\t\t\t" << fname << ".resize(__" << fname << "_sz);" << endl
-		<< "\t\t\t__s.ignore(1);" << endl // skip the whitespace separator
-		<< "\t\t\t__s.get(&" << fname << ".front(), __" << fname << "_sz+1, '\\0');" << endl; // +1 because .get reads n-1 chars
+	if (dict_mode) return r_dict_string(fname, fname + " = **__ds_" + fname, o);
+	o << "\t\t\tsize_t __" << fname << "_sz; ; __s >> __" << fname << "_sz;" << '\n'
+		<< "\t\t\t" << fname << ".resize(__" << fname << "_sz);" << '\n'
+		<< "\t\t\t__s.ignore(1);" << '\n' // skip the whitespace separator
+		<< "\t\t\t__s.read(&" << fname << "[0], __" << fname << "_sz);" << '\n';
+}
+
+string length_of(const NType& t); // declared down
+
+// lets the coroutine-based serializer suspend when its buffer is full, inside loops
+void yield_point(ostream& o) {
+	if (async_mode) o << "\t__AS_YIELD;" << '\n';
 }
 
 #define _GENERATE_FOR_SZ(sz_value) \
 	"\tfor (size_t __i_" << fname << " = 0; " \
 	<< "__i_" << fname << " < " << sz_value << "; "	\
-	<< "__i_" << fname << "++) {" << endl
+	<< "__i_" << fname << "++) {" << '\n'
 #define _GENERATE_FOR _GENERATE_FOR_SZ("__" << fname << "_sz")
 
-void w_static_array(const string& fname, const NType& t, ostream& o) {
-	const NType& e_t = *(*t.generics)[0];
-	const string& size = t.name->value;	
-	o << "\t__s << (" << size << ");" << endl
+// static arrays and `std::array` share the same format: size, then every element
+void w_array_of(const string& fname, const NType& e_t, const string& size, ostream& o) {
+	o << "\t__s << (" << size << ");" << '\n'
 		<< _GENERATE_FOR_SZ("(" << size << ")")
-		<< "\tconst auto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << endl
-		<< "\t__s << ' ';" << endl;
+		<< "\tconst auto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << '\n'
+		<< "\t__s << ' ';" << '\n';
 	serialize_value("__e_" + fname, e_t, o);
-	o << "\t}" << endl;
+	yield_point(o);
+	o << "\t}" << '\n';
 }
 
-void r_static_array(const string& fname, const NType& t, ostream& o) {
-	const NType& e_t = *(*t.generics)[0];
-	const string& size = t.name->value;	
-	o << "\t\t\tsize_t __" << fname << "_sz; __s >> __" << fname << "_sz;" << endl
+void r_array_of(const string& fname, const NType& e_t, const string& size, ostream& o) {
+	o << "\t\t\tsize_t __" << fname << "_sz; __s >> __" << fname << "_sz;" << '\n'
 		<< "\t\t\tif (__" << fname << "_sz != (" << size << ")) "
 		<< "if (__e(\"wrong static array size: got \" + to_string(__" << fname << "_sz)"
-		<< "+ \", expected \" + to_string(" << size << "))) return 0;" << endl
+		<< "+ \", expected \" + to_string(" << size << "))) return 0;" << '\n'
 		<< "\t\t" << _GENERATE_FOR
-		<< "\t\t\tauto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << endl;
+		<< "\t\t\tauto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << '\n';
 	deserialize_value("__e_" + fname, e_t, o);
-	o << "\t}" << endl;
+	o << "\t}" << '\n';
+}
+
+void s_array_of(const string& fname, const NType& e_t, const string& size, ostream& o) {
+	o << "\t__pm.size += __as_digits((size_t) (" << size << "));" << '\n';
+	const auto each = [&]() {
+		o << _GENERATE_FOR_SZ("(" << size << ")")
+			<< "\tconst auto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << '\n'
+			<< "\t__pm.size += 1;" << '\n';
+		size_value("__e_" + fname, e_t, o);
+		o << "\t}" << '\n';
+	};
+	if (!size_constant(e_t, o, [&](const string& e) { return "__pm.size += (" + size + ") * (1 + " + e + ");"; }, each))
+		each();
+}
+
+// arrays of values with a constant length have a constant length too
+constant_length c_array_of(const NType& e_t, const string& size) {
+	constant_length c = constant_size(e_t);
+	if (!c.value.empty())
+		c.value = "__as_digits((size_t) (" + size + ")) + (" + size + ") * (1 + " + c.value + ")";
+	return c;
+}
+
+// elements without heap memory of their own (e.g. `std::optional<int>`) generate no loop
+void h_array_of(const string& fname, const NType& e_t, const string& size, ostream& o) {
+	if (!owns_heap(&e_t)) return;
+	ostringstream body;
+	heap_value("__e_" + fname, e_t, body);
+	if (body.str().empty()) return;
+	o << _GENERATE_FOR_SZ("(" << size << ")")
+		<< "\tconst auto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << '\n'
+		<< body.str()
+		<< "\t}" << '\n';
+}
+
+void w_static_array(const string& fname, const NType& t, ostream& o) {
+	w_array_of(fname, *(*t.generics)[0], t.name->value, o);
+}
+
+void r_static_array(const string& fname, const NType& t, ostream& o) {
+	r_array_of(fname, *(*t.generics)[0], t.name->value, o);
+}
+
+void s_static_array(const string& fname, const NType& t, ostream& o) {
+	s_array_of(fname, *(*t.generics)[0], t.name->value, o);
+}
+
+void h_static_array(const string& fname, const NType& t, ostream& o) {
+	h_array_of(fname, *(*t.generics)[0], t.name->value, o);
+}
+
+constant_length c_static_array(const NType& t) {
+	return c_array_of(*(*t.generics)[0], t.name->value);
+}
+
+void w_std_array(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	if (list.size() != 2) throw runtime_error("std::array is expected to have a type and a size, but got: " + to_string(t));
+	w_array_of(fname, *list[0], to_cpp_type(*list[1]), o);
+}
+
+void r_std_array(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	r_array_of(fname, *list[0], to_cpp_type(*list[1]), o);
+}
+
+void s_std_array(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	s_array_of(fname, *list[0], to_cpp_type(*list[1]), o);
+}
+
+void h_std_array(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	h_array_of(fname, *list[0], to_cpp_type(*list[1]), o);
+}
+
+constant_length c_std_array(const NType& t) {
+	const GenericsList& list = *t.generics;
+	return c_array_of(*list[0], to_cpp_type(*list[1]));
+}
+
+// pointers, shared and unique pointers, whose order depends on memory addresses
+bool is_pointer_type(const NType* t) {
+	find_type_pair(t);
+	const string& name = t->name->value;
+	return !t->isArray && (name == "*" || name == "shared_ptr" || name == "std::shared_ptr"
+		|| name == "unique_ptr" || name == "std::unique_ptr");
+}
+
+/* generates a loop over the elements `__e_<fname>` of a container, with `body` generating its body.
+ * in canonical mode unordered containers, and sets and maps of pointers, are iterated in sorted order
+ * (see `__as_canonical_order`), so that equal containers produce the same output. keys which can't be ordered make the stream fail */
+void w_for_each(const string& fname, const NType& t, ostream& o, const function<void()>& body) {
+	const string& n = t.name->value;
+	const string name = n.compare(0, 5, "std::") ? n : n.substr(5);
+	bool sorted = name == "unordered_set" || name == "unordered_map"
+		|| ((name == "set" || name == "map") && is_pointer_type((*t.generics)[0]));
+	if (sorted) o << "\tif (!__pm.canonical) {" << '\n';
+	o << "\tfor (const auto& __e_" << fname << " : " << fname << ") {" << '\n';
+	body();
+	o << "\t}" << '\n';
+	if (!sorted) return;
+	o << "\t} else {" << '\n'
+		<< "\tvector<const decay_t<decltype(" << fname << ")>::value_type*> __c_" << fname << ";" << '\n'
+		<< "\tif (!__as_canonical_order(__pm, " << fname << ", __c_" << fname << ")) __s.setstate(ios::failbit);" << '\n'
+		<< "\tfor (const auto* __ce_" << fname << " : __c_" << fname << ") {" << '\n'
+		<< "\tconst auto& __e_" << fname << " = *__ce_" << fname << ";" << '\n';
+	body();
+	o << "\t}" << '\n'
+		<< "\t}" << '\n';
+}
+
+/* vectors of structs with only native fields are written as a single block of raw memory, when not empty:
+ * returns the layout id of the elements, and their real type */
+const string* raw_span_layout(const NType& t, const NType*& e_t) {
+	const string& name = t.name->value;
+	if (name != "vector" && name != "std::vector") return nullptr;
+	e_t = (*t.generics)[0];
+	if (&find_type_pair(e_t) != &rw_object) return nullptr;
+	return raw_layout_of(*e_t);
 }
 
 void w_vector(const string& fname, const NType& t, ostream& o) {
-	GenericsList& list = *t.generics;
-	if (list.size() < 1) throw runtime_error("std::vector, std:set or std::unordered_set are expected to have at least one generic type, but got: " + to_string(t));
+	const GenericsList& list = *t.generics;
+	if (list.size() < 1) throw runtime_error("std::vector, std::deque, std:set or std::unordered_set are expected to have at least one generic type, but got: " + to_string(t));
 	const NType& e_t = *list[0];
-	o << "\t__s << " << fname << ".size() << ' '; " << endl
-		<< "\tfor (const auto& __e_" << fname << " : " << fname << ") {" << endl;
-	serialize_value("__e_" + fname, e_t, o);
-	o << "\t__s << ' ';" << endl;
-	o << "\t}" << endl;
+	o << "\t__s << " << fname << ".size() << ' '; " << '\n';
+	const NType* raw_t;
+	if (const string* layout = raw_span_layout(t, raw_t)) {
+		const string e_cpp = to_cpp_type(*raw_t);
+		o << "\tif (" << e_cpp << "::_is_raw() && !" << fname << ".empty()) {" << '\n'
+			<< "\t__s << \"#raw " << *layout << "/\" << sizeof(" << e_cpp << ") << ' ';" << '\n';
+		write_block(fname, fname + ".data()", fname + ".size() * sizeof(" + e_cpp + ")", o);
+		o << "\t} else" << '\n';
+	}
+	w_for_each(fname, t, o, [&]() {
+		serialize_value("__e_" + fname, e_t, o);
+		o << "\t__s << ' ';" << '\n';
+		yield_point(o);
+	});
+}
+
+// the order of the elements doesn't change the length, so it is never sorted
+void s_vector(const string& fname, const NType& t, ostream& o) {
+	o << "\t__pm.size += __as_digits(" << fname << ".size()) + 1;" << '\n';
+	const NType* raw_t;
+	if (const string* layout = raw_span_layout(t, raw_t)) {
+		const string e_cpp = to_cpp_type(*raw_t);
+		o << "\tif (" << e_cpp << "::_is_raw() && !" << fname << ".empty()) "
+			<< "__pm.size += " << 5 + layout->size() + 1 << " + __as_digits(sizeof(" << e_cpp << ")) + 1 + " << fname << ".size() * sizeof(" << e_cpp << ");" << '\n'
+			<< "\telse" << '\n';
+	}
+	const auto each = [&]() {
+		o << "\tfor (const auto& __e_" << fname << " : " << fname << ") {" << '\n';
+		size_value("__e_" + fname, *(*t.generics)[0], o);
+		o << "\t__pm.size += 1;" << '\n'
+			<< "\t}" << '\n';
+	};
+	if (!size_constant(*(*t.generics)[0], o, [&](const string& e) { return "__pm.size += " + fname + ".size() * (" + e + " + 1);"; }, each))
+		each();
+}
+
+/* the buffer of vectors, and an estimate for the other containers: a node per element,
+ * with a few pointers each (see `__as_node_heap`), and the buckets of unordered ones */
+void h_container(const string& fname, const NType& t, ostream& o) {
+	const string& n = t.name->value;
+	const string name = n.compare(0, 5, "std::") ? n : n.substr(5);
+	if (name == "vector") {
+		const NType* e_t = (*t.generics)[0];
+		find_type_pair(e_t);
+		if (e_t->name->value == "bool" && !e_t->isArray) // a bit per element
+			o << "\t__pm.bytes += (" << fname << ".capacity() + 7) / 8;" << '\n';
+		else
+			o << "\t__pm.bytes += " << fname << ".capacity() * sizeof(" << to_cpp_type(*e_t) << ");" << '\n';
+		return;
+	}
+	const int pointers = name == "deque" ? 0 : name.compare(0, 10, "unordered_") ? 3 : 1;
+	o << "\t__pm.bytes += __as_node_heap(" << fname << ", " << pointers << ")";
+	if (pointers == 1) o << " + " << fname << ".bucket_count() * sizeof(void*)";
+	o << ";" << '\n';
+}
+
+void h_vector(const string& fname, const NType& t, ostream& o) {
+	h_container(fname, t, o);
+	const NType& e_t = *(*t.generics)[0];
+	if (!owns_heap(&e_t)) return;
+	ostringstream body;
+	heap_value("__e_" + fname, e_t, body);
+	if (body.str().empty()) return;
+	o << "\tfor (const auto& __e_" << fname << " : " << fname << ") {" << '\n'
+		<< body.str()
+		<< "\t}" << '\n';
+}
+
+// pointers and shared pointers, which are filled once every value is read
+bool filled_later(const NType* t) {
+	find_type_pair(t);
+	const string& name = t->name->value;
+	return !t->isArray && (name == "*" || name == "shared_ptr" || name == "std::shared_ptr");
 }
 
 void r_vector(const string& fname, const NType& t, ostream& o) {
 	const NType& e_t = *(*t.generics)[0];  // checks already performed when writing
-	o << "\t\t\tsize_t __" << fname << "_sz; __s >> __" << fname << "_sz;" << endl;
+	o << "\t\t\tsize_t __" << fname << "_sz; __s >> __" << fname << "_sz;" << '\n';
 	// can't preallocate sets and unorderes_sets
-	if (t.name->value == "vector" || t.name->value == "std::vector") {
-		o << "\t\t\t" << fname << ".resize(__" << fname << "_sz);" << endl
+	const string& name = t.name->value;
+	if (name == "vector" || name == "std::vector" || name == "deque" || name == "std::deque") {
+		o << "\t\t\t" << fname << ".resize(__" << fname << "_sz);" << '\n';
+		const NType* raw_t;
+		if (const string* layout = raw_span_layout(t, raw_t)) {
+			// also reads the elements one by one, as written when the layout has padding
+			const string e_cpp = to_cpp_type(*raw_t);
+			o << "\t\t\tif (" << e_cpp << "::_is_raw() && __" << fname << "_sz && (__s >> ws).peek() == '#') {" << '\n'
+				<< "\t\t\t__TYPE_CHK(\"#raw\");" << '\n'
+				<< "\t\t\t__TYPE_CHK(\"" << *layout << "/\" + to_string(sizeof(" << e_cpp << ")));" << '\n'
+				<< "\t\t\t__s.ignore(1);" << '\n' // skip the whitespace separator
+				<< "\t\t\t__s.read((char*) " << fname << ".data(), __" << fname << "_sz * sizeof(" << e_cpp << "));" << '\n'
+				<< "\t\t\tif (__s.fail()) if (__e(__AS_CTX \"." << fname << ": expected \" + to_string(__" << fname << "_sz) + \" values, but reading failed\")) return 0;" << '\n'
+				<< "\t\t\t} else" << '\n';
+		}
+		o << "\t\t" << _GENERATE_FOR
+			<< "\t\t\tauto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << '\n';
+		deserialize_value("__e_" + fname, e_t, o);
+	} else if (filled_later(&e_t)) {
+		// the elements need a fixed address until the pointers are filled, then they are inserted
+		o << "\t\t\tauto* __h_" << fname << " = new vector<" << to_cpp_type(e_t) << ">(__" << fname << "_sz);" << '\n'
+			<< "\t\t\t__pm.insert_later(" << fname << ", __h_" << fname << ");" << '\n'
 			<< "\t\t" << _GENERATE_FOR
-			<< "\t\t\tauto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << endl;
+			<< "\t\t\tauto& __e_" << fname << " = (*__h_" << fname << ")[__i_" << fname << "];" << '\n';
 		deserialize_value("__e_" + fname, e_t, o);
 	} else {
 		o << "\t\t" << _GENERATE_FOR
-			<< "\t\t\t" << e_t << " __e_" << fname << ";" << endl;
+			<< "\t\t\t" << to_cpp_type(e_t) << " __e_" << fname << ";" << '\n';
 		deserialize_value("__e_" + fname, e_t, o);
-		o << "\t\t\t" << fname << ".insert(__e_" << fname << ");" << endl;
+		o << "\t\t\t" << fname << ".insert(__e_" << fname << ");" << '\n';
 	}
-	o << "\t\t\t}" << endl;
+	o << "\t\t\t}" << '\n';
 }
 
 void w_map(const string& fname, const NType& t, ostream& o) {
-	GenericsList& list = *t.generics;
+	const GenericsList& list = *t.generics;
 	if (list.size() < 2) throw runtime_error("std::map or std::unordered_map are expected to have at least two generic types, but got: " + to_string(t));
 	const NType& k_t = *list[0], &v_t = *list[1];
-	o << "\t__s << " << fname << ".size() << ' '; " << endl
-		<< "\tfor (const auto& __e_" << fname << " : " << fname << ") {" << endl
+	o << "\t__s << " << fname << ".size() << ' '; " << '\n';
+	w_for_each(fname, t, o, [&]() {
+		o << "\tconst auto& __k_" << fname << " = __e_" << fname << ".first; "
+			<< "const auto& __v_" << fname << " = __e_" << fname << ".second;" << '\n';
+		serialize_value("__k_" + fname, k_t, o);
+		o << "\t__s << ' ';" << '\n';
+		serialize_value("__v_" + fname, v_t, o);
+		o << "\t__s << ' ';" << '\n';
+		yield_point(o);
+	});
+}
+
+void s_map(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	o << "\t__pm.size += __as_digits(" << fname << ".size()) + 1;" << '\n'
+		<< "\tfor (const auto& __e_" << fname << " : " << fname << ") {" << '\n'
 		<< "\tconst auto& __k_" << fname << " = __e_" << fname << ".first; "
-		<< "const auto& __v_" << fname << " = __e_" << fname << ".second;" << endl;
-	serialize_value("__k_" + fname, k_t, o);
-	o << "\t__s << ' ';" << endl;
-	serialize_value("__v_" + fname, v_t, o);
-	o << "\t__s << ' ';" << endl;
-	o << "\t}" << endl;
+		<< "const auto& __v_" << fname << " = __e_" << fname << ".second;" << '\n';
+	size_value("__k_" + fname, *list[0], o);
+	size_value("__v_" + fname, *list[1], o);
+	o << "\t__pm.size += 2;" << '\n'
+		<< "\t}" << '\n';
+}
+
+void h_map(const string& fname, const NType& t, ostream& o) {
+	h_container(fname, t, o);
+	const GenericsList& list = *t.generics;
+	const bool k_heap = owns_heap(list[0]), v_heap = owns_heap(list[1]);
+	if (!k_heap && !v_heap) return;
+	o << "\tfor (const auto& __e_" << fname << " : " << fname << ") {" << '\n';
+	if (k_heap) {
+		o << "\tconst auto& __k_" << fname << " = __e_" << fname << ".first;" << '\n';
+		heap_value("__k_" + fname, *list[0], o);
+	}
+	if (v_heap) {
+		o << "\tconst auto& __v_" << fname << " = __e_" << fname << ".second;" << '\n';
+		heap_value("__v_" + fname, *list[1], o);
+	}
+	o << "\t}" << '\n';
 }
 
 void r_map(const string& fname, const NType& t, ostream& o) {
-	GenericsList& list = *t.generics;
+	const GenericsList& list = *t.generics;
 	const NType& k_t = *list[0], &v_t = *list[1]; // checks already performed when writing
-	o << "\t\t\tsize_t __" << fname << "_sz; ; __s >> __" << fname << "_sz;" << endl
-		<< "\t\t" << _GENERATE_FOR
-		<< "\t\t\t" << to_cpp_type(k_t) << " __k_" << fname << ";" << endl;
-	deserialize_value("__k_" + fname, k_t, o);
-	o << "\t\t\t" << to_cpp_type(v_t) << "& __v_" << fname << " = " << fname << "[__k_" << fname << "];" << endl;
+	o << "\t\t\tsize_t __" << fname << "_sz; ; __s >> __" << fname << "_sz;" << '\n';
+	if (filled_later(&k_t)) {
+		// like sets of pointers, the elements are inserted once the keys are filled
+		o << "\t\t\tauto* __h_" << fname << " = new vector<pair<" << to_cpp_type(k_t) << ", " << to_cpp_type(v_t) << ">>(__" << fname << "_sz);" << '\n'
+			<< "\t\t\t__pm.insert_later(" << fname << ", __h_" << fname << ");" << '\n'
+			<< "\t\t" << _GENERATE_FOR
+			<< "\t\t\tauto& __k_" << fname << " = (*__h_" << fname << ")[__i_" << fname << "].first;" << '\n';
+		deserialize_value("__k_" + fname, k_t, o);
+		o << "\t\t\tauto& __v_" << fname << " = (*__h_" << fname << ")[__i_" << fname << "].second;" << '\n';
+	} else {
+		o << "\t\t" << _GENERATE_FOR
+			<< "\t\t\t" << to_cpp_type(k_t) << " __k_" << fname << ";" << '\n';
+		deserialize_value("__k_" + fname, k_t, o);
+		o << "\t\t\t" << to_cpp_type(v_t) << "& __v_" << fname << " = " << fname << "[__k_" << fname << "];" << '\n';
+	}
 	deserialize_value("__v_" + fname, v_t, o);
-	o << "\t\t\t}" << endl;
+	o << "\t\t\t}" << '\n';
 }
 
 void r_object(const string& fname, const NType& t, ostream& o) {
-	o << "\t\t\tif (!" << fname << "._deserialize_from(__s, __e, __pm)) return 0;" << endl;	
+	o << "\t\t\tif (!" << fname << "._deserialize_from(__s, __e, __pm)) return 0;" << '\n';	
 }
 
 void w_object(const string& fname, const NType& t, ostream& o) {
-	o << "\t" << fname << "._serialize_to(__s, __pm);" << endl;	
+	if (async_mode)
+		o << "\tco_await " << fname << "._serialize_async(__w, __pm);" << '\n';
+	else
+		o << "\t" << fname << "._serialize_to(__s, __pm);" << '\n';
 }
 
-void r_pointer(const string& fname, const NType& t, ostream& o) {
-	// tell the root deserializer that the pointer needs to be filled here
+void s_object(const string& fname, const NType& t, ostream& o) {
+	o << "\t" << fname << "._serialized_size(__pm);" << '\n';
+}
+
+// structs written as raw memory, when their layout has no padding
+constant_length c_object(const NType& t) {
+	const string* layout = raw_layout_of(t);
+	if (!layout) return {};
+	const string name = to_cpp_type(t);
+	return { raw_struct_size(name, *layout), name + "::_is_raw()" };
+}
+
+void h_object(const string& fname, const NType& t, ostream& o) {
+	o << "\t" << fname << "._memory_heap(__pm);" << '\n';
+}
+
+// generates the callback which allocates and reads a pointed value, assigning it to `target`
+void pointed_value_reader(const string& fname, const NType& t, const string& target, ostream& o) {
 	const NType* ptr_pointed_t = (*t.generics)[0];
 	const NType& pointed_t = *ptr_pointed_t;
-	o << "\t\t\tsize_t __p_" << fname << "; __s >> __p_" << fname << ";" << endl
-		<< "\t\t\tif (__p_" << fname << " == 0) {" << endl
-		<< "\t\t\t" << fname << " = nullptr;" << endl
-		<< "\t\t\t" << "} else {" << endl
-		<< "\t\t\t__deserialization_ptr& __d_" << fname << " = __pm[__p_" << fname << "];" << endl
-		<< "\t\t\t__d_" << fname << ".refs.push_back(&" << fname << ");" << endl
-		<< "\t\t\t__d_" << fname << ".fun = [&, __e]() -> void* {" << endl;
+	// captureless, so that it doesn't allocate
+	o << "\t\t\t" << target << " = [](__DS_ARGS) -> void* {" << '\n';
 	if (&find_type_pair(ptr_pointed_t) == &rw_object) {
 		// for serializable objects, use the deserialize_to_ptr, which handles polymorphism
-		o << "\t\t\treturn " << pointed_t << "::_deserialize_to_ptr(__s, __e, __pm);" << endl;
+		o << "\t\t\treturn " << pointed_t << "::_deserialize_to_ptr(__s, __e, __pm);" << '\n';
 	} else {
 		// for other types, deserialize as usual
-		o << "\t\t\t" << pointed_t << "* __v_" << fname << " = new " << pointed_t << "();" << endl
-			<< "\t\t\t" << pointed_t << "& __r_" << fname << " = *__v_" << fname << ";" << endl;
+		o << "\t\t\t" << pointed_t << "* __v_" << fname << " = new " << pointed_t << "();" << '\n'
+			<< "\t\t\t" << pointed_t << "& __r_" << fname << " = *__v_" << fname << ";" << '\n';
 		deserialize_value("__r_" + fname, pointed_t, o);
-		o << "\t\t\treturn __v_" << fname << ";" << endl;
+		o << "\t\t\treturn __v_" << fname << ";" << '\n';
 	}
-	o << "\t\t\t};" << endl
-		<< "\t\t\t}" << endl;
+	o << "\t\t\t};" << '\n';
 }
 
-void w_pointer(const string& fname, const NType& t, ostream& o) {
+// the callback used once the definition of the pointed value is found
+void r_pointed_value(const string& fname, const NType& t, ostream& o) {
+	pointed_value_reader(fname, t, "__d_" + fname + ".fun", o);
+}
+
+void r_pointer(const string& fname, const NType& t, ostream& o) {
+	// tell the root deserializer that the pointer needs to be filled here
+	o << "\t\t\tsize_t __p_" << fname << "; __s >> __p_" << fname << ";" << '\n'
+		<< "\t\t\tif (__p_" << fname << " == 0) {" << '\n'
+		<< "\t\t\t" << fname << " = nullptr;" << '\n'
+		<< "\t\t\t" << "} else {" << '\n'
+		<< "\t\t\t__deserialization_ptr& __d_" << fname << " = __pm.ref(__p_" << fname << ");" << '\n'
+		<< "\t\t\t__d_" << fname << ".refs.push_back(&" << fname << ");" << '\n';
+	r_pointed_value(fname, t, o);
+	o << "\t\t\t}" << '\n';
+}
+
+// `ptr` is an expression evaluating to the raw pointer
+void w_pointer_to(const string& fname, const string& ptr, const NType& t, ostream& o) {
 	// tell the root serializer to serialize this pointer later
+	// pointed values get sequential ids, null pointers are 0
+	const NType& pointed_t = *(*t.generics)[0];
+	const string pointed_cpp = to_cpp_type(pointed_t);
+	o << "\tif (!" << ptr << ") __s << 0;" << '\n'
+		<< "\telse if (size_t __id_" << fname << " = __pm.find(" << ptr << ")) __s << __id_" << fname << ";" << '\n'
+		<< "\telse {" << '\n';
+	// captureless, so that it doesn't allocate
+	if (async_mode) {
+		o << "\t__s << __pm.add(" << ptr << ", { " << ptr << ", [](const void* __v, __as_async_buffer& __w, __as_async_state& __pm) -> __as_task {" << '\n'
+			<< "\t[[maybe_unused]] ostream& __s = __w.stream();" << '\n' // unused by structs, which write themselves
+			<< "\tconst " << pointed_cpp << "& __p_" << fname << " = *(const " << pointed_cpp << "*) __v;" << '\n';
+		serialize_value("__p_" + fname, pointed_t, o);
+		o << "\tco_return;" << '\n'
+			<< "\t} });" << '\n';
+	} else {
+		o << "\t__s << __pm.add(" << ptr << ", { " << ptr << ", [](const void* __v, ostream& __s, __serialization_state& __pm) {" << '\n'
+			<< "\tconst " << pointed_cpp << "& __p_" << fname << " = *(const " << pointed_cpp << "*) __v;" << '\n';
+		serialize_value("__p_" + fname, pointed_t, o);
+		o << "\t} });" << '\n';
+	}
+	o << "\t}" << '\n';
+}
+
+// follows the same pointer graph as `w_pointer_to`, so that ids have the same length
+void s_pointer_to(const string& fname, const string& ptr, const NType& t, ostream& o) {
 	const NType& pointed_t = *(*t.generics)[0];
-	o << "\t__s << ((size_t) " << fname << ");" << endl
-		<< "\tif (" << fname << ") {" << endl // don't serialize null pointers
-		<< "\t" << pointed_t << "& __p_" << fname << " = *" << fname << ";" << endl
-		<< "\t__pm[" << fname << "] = [&](){" << endl;
-	serialize_value("__p_" + fname, pointed_t, o);
-	o << "\t};" << endl
-		<< "\t}" << endl;
+	const string pointed_cpp = to_cpp_type(pointed_t);
+	o << "\tif (!" << ptr << ") __pm.size += 1;" << '\n'
+		<< "\telse if (size_t __id_" << fname << " = __pm.find(" << ptr << ")) __pm.size += __as_digits(__id_" << fname << ");" << '\n'
+		<< "\telse {" << '\n'
+		<< "\t__pm.size += __as_digits(__pm.add(" << ptr << ", { " << ptr << ", [](const void* __v, __size_state& __pm) {" << '\n'
+		<< "\tconst " << pointed_cpp << "& __p_" << fname << " = *(const " << pointed_cpp << "*) __v;" << '\n';
+	size_value("__p_" + fname, pointed_t, o);
+	o << "\t} }));" << '\n'
+		<< "\t}" << '\n';
+}
+
+void s_pointer(const string& fname, const NType& t, ostream& o) {
+	s_pointer_to(fname, fname, t, o);
+}
+
+/* pointed values are counted once, the first time they are found, with their own heap memory.
+ * `ptr` is an expression evaluating to the raw pointer, `overhead` the bytes allocated along with the value */
+void h_pointer_to(const string& fname, const string& ptr, const NType& t, const string& overhead, ostream& o) {
+	const NType* pointed_t = (*t.generics)[0];
+	const string pointed_cpp = to_cpp_type(*pointed_t);
+	const bool object = &find_type_pair(pointed_t) == &rw_object;
+	o << "\tif (__pm.first(" << ptr << ")) {" << '\n';
+	if (!overhead.empty())
+		o << "\t__pm.bytes += " << overhead << ";" << '\n';
+	if (!object && !owns_heap(pointed_t)) {
+		o << "\t__pm.bytes += sizeof(" << pointed_cpp << ");" << '\n'
+			<< "\t}" << '\n';
+		return;
+	}
+	// captureless, so that it doesn't allocate
+	o << "\t__pm.pending.push_back({ " << ptr << ", [](const void* __v, __footprint_state& __pm) {" << '\n';
+	if (object) {
+		// handles polymorphism
+		o << "\t((const " << pointed_cpp << "*) __v)->_memory_pointee(__pm);" << '\n';
+	} else {
+		o << "\t__pm.bytes += sizeof(" << pointed_cpp << ");" << '\n'
+			<< "\tconst " << pointed_cpp << "& __p_" << fname << " = *(const " << pointed_cpp << "*) __v;" << '\n';
+		heap_value("__p_" + fname, *pointed_t, o);
+	}
+	o << "\t} });" << '\n'
+		<< "\t}" << '\n';
+}
+
+void h_pointer(const string& fname, const NType& t, ostream& o) {
+	h_pointer_to(fname, fname, t, "", o);
+}
+
+void w_pointer(const string& fname, const NType& t, ostream& o) {
+	w_pointer_to(fname, fname, t, o);
+}
+
+// in `@dict` fields, shared strings are written by value, and equal strings share their value when read
+bool is_dict_string(const NType& t) {
+	const NType* real_t = (*t.generics)[0];
+	find_type_pair(real_t);
+	return dict_mode && (real_t->name->value == "std::string" || real_t->name->value == "string");
+}
+
+// shared pointers use the same format as raw pointers, so that the pointed value is written once
+void w_shared_ptr(const string& fname, const NType& t, ostream& o) {
+	if (is_dict_string(t)) {
+		o << "\tif (!" << fname << ") __s << '!';" << '\n'
+			<< "\telse {" << '\n';
+		w_dict_string(fname, "(*" + fname + ")", o);
+		o << "\t}" << '\n';
+		return;
+	}
+	w_pointer_to(fname, fname + ".get()", t, o);
+}
+
+void s_shared_ptr(const string& fname, const NType& t, ostream& o) {
+	if (is_dict_string(t)) {
+		o << "\tif (!" << fname << ") __pm.size += 1;" << '\n'
+			<< "\telse {" << '\n';
+		s_dict_string(fname, "(*" + fname + ")", o);
+		o << "\t}" << '\n';
+		return;
+	}
+	s_pointer_to(fname, fname + ".get()", t, o);
+}
+
+void h_shared_ptr(const string& fname, const NType& t, ostream& o) {
+	h_pointer_to(fname, fname + ".get()", t, "__as_shared_block", o);
+}
+
+void r_shared_ptr(const string& fname, const NType& t, ostream& o) {
+	if (is_dict_string(t)) {
+		o << "\t\t\t__s >> ws;" << '\n'
+			<< "\t\t\tif (__s.peek() == '!') {" << '\n'
+			<< "\t\t\t__s.get();" << '\n'
+			<< "\t\t\t" << fname << ".reset();" << '\n'
+			<< "\t\t\t} else {" << '\n';
+		r_dict_string(fname, fname + " = *__ds_" + fname, o);
+		o << "\t\t\t}" << '\n';
+		return;
+	}
+	const string pointed_cpp = to_cpp_type(*(*t.generics)[0]);
+	o << "\t\t\tsize_t __p_" << fname << "; __s >> __p_" << fname << ";" << '\n'
+		<< "\t\t\tif (__p_" << fname << " == 0) {" << '\n'
+		<< "\t\t\t" << fname << ".reset();" << '\n'
+		<< "\t\t\t" << "} else {" << '\n'
+		<< "\t\t\t__deserialization_ptr& __d_" << fname << " = __pm.ref(__p_" << fname << ");" << '\n'
+		// the first reference creates the owner, the following ones share it
+		<< "\t\t\t__d_" << fname << ".shared_refs.push_back({ &" << fname << ", [](void* __t, void* __v, shared_ptr<void>& __h) {" << '\n'
+		<< "\t\t\tif (!__h) __h = shared_ptr<" << pointed_cpp << ">((" << pointed_cpp << "*) __v);" << '\n'
+		<< "\t\t\t*(shared_ptr<" << pointed_cpp << ">*) __t = static_pointer_cast<" << pointed_cpp << ">(__h);" << '\n'
+		<< "\t\t\t} });" << '\n';
+	r_pointed_value(fname, t, o);
+	o << "\t\t\t}" << '\n';
+}
+
+/* pointers read on first access: `lazy<type>`, written like raw pointers.
+ * from a lazy source the handle keeps the id, otherwise the value is read as usual */
+void w_lazy(const string& fname, const NType& t, ostream& o) {
+	w_pointer_to(fname, fname + ".get()", t, o);
+}
+
+void s_lazy(const string& fname, const NType& t, ostream& o) {
+	s_pointer_to(fname, fname + ".get()", t, o);
+}
+
+// values not read yet are not counted
+void h_lazy(const string& fname, const NType& t, ostream& o) {
+	h_pointer_to(fname, "(" + fname + ".loaded() ? " + fname + ".get() : nullptr)", t, "", o);
+}
+
+void r_lazy(const string& fname, const NType& t, ostream& o) {
+	o << "\t\t\tsize_t __p_" << fname << "; __s >> __p_" << fname << ";" << '\n';
+	pointed_value_reader(fname, t, "__as_lazy_source::fun_t __f_" + fname, o);
+	o << "\t\t\tif (__p_" << fname << " == 0) {" << '\n'
+		<< "\t\t\t" << fname << " = nullptr;" << '\n'
+		<< "\t\t\t} else if (__pm.lazy) {" << '\n'
+		<< "\t\t\t" << fname << "._set_lazy(__pm.lazy->shared_from_this(), __p_" << fname << ", __f_" << fname << ");" << '\n'
+		<< "\t\t\t" << "} else {" << '\n'
+		<< "\t\t\t__deserialization_ptr& __d_" << fname << " = __pm.ref(__p_" << fname << ");" << '\n'
+		<< "\t\t\t__d_" << fname << ".refs.push_back(&" << fname << "._ptr());" << '\n'
+		<< "\t\t\t__d_" << fname << ".fun = __f_" << fname << ";" << '\n'
+		<< "\t\t\t}" << '\n';
+}
+
+// unique pointers own their value, so it is written inline
+void w_unique_ptr(const string& fname, const NType& t, ostream& o) {
+	const NType& pointed_t = *(*t.generics)[0];
+	o << "\t__s << (" << fname << " != nullptr) << ' ';" << '\n'
+		<< "\tif (" << fname << ") {" << '\n'
+		<< "\tconst auto& __u_" << fname << " = *" << fname << ";" << '\n';
+	serialize_value("__u_" + fname, pointed_t, o);
+	o << "\t}" << '\n';
+}
+
+void s_unique_ptr(const string& fname, const NType& t, ostream& o) {
+	o << "\t__pm.size += 2;" << '\n'
+		<< "\tif (" << fname << ") {" << '\n'
+		<< "\tconst auto& __u_" << fname << " = *" << fname << ";" << '\n';
+	size_value("__u_" + fname, *(*t.generics)[0], o);
+	o << "\t}" << '\n';
+}
+
+void h_unique_ptr(const string& fname, const NType& t, ostream& o) {
+	h_pointer_to(fname, fname + ".get()", t, "", o);
+}
+
+void r_unique_ptr(const string& fname, const NType& t, ostream& o) {
+	const NType* ptr_pointed_t = (*t.generics)[0];
+	const string pointed_cpp = to_cpp_type(*ptr_pointed_t);
+	o << "\t\t\tbool __h_" << fname << "; __s >> __h_" << fname << ";" << '\n'
+		<< "\t\t\tif (!__h_" << fname << ") " << fname << ".reset();" << '\n'
+		<< "\t\t\telse {" << '\n';
+	if (&find_type_pair(ptr_pointed_t) == &rw_object) {
+		// handles polymorphism
+		o << "\t\t\t" << fname << ".reset((" << pointed_cpp << "*) " << pointed_cpp << "::_deserialize_to_ptr(__s, __e, __pm));" << '\n'
+			<< "\t\t\tif (!" << fname << ") return 0;" << '\n';
+	} else {
+		o << "\t\t\t" << fname << ".reset(new " << pointed_cpp << "());" << '\n'
+			<< "\t\t\tauto& __u_" << fname << " = *" << fname << ";" << '\n';
+		deserialize_value("__u_" + fname, *ptr_pointed_t, o);
+	}
+	o << "\t\t\t}" << '\n';
+}
+
+void w_optional(const string& fname, const NType& t, ostream& o) {
+	o << "\t__s << " << fname << ".has_value() << ' ';" << '\n'
+		<< "\tif (" << fname << ") {" << '\n'
+		<< "\tconst auto& __o_" << fname << " = *" << fname << ";" << '\n';
+	serialize_value("__o_" + fname, *(*t.generics)[0], o);
+	o << "\t}" << '\n';
+}
+
+void s_optional(const string& fname, const NType& t, ostream& o) {
+	o << "\t__pm.size += 2;" << '\n';
+	const auto each = [&]() {
+		o << "\tif (" << fname << ") {" << '\n'
+			<< "\tconst auto& __o_" << fname << " = *" << fname << ";" << '\n';
+		size_value("__o_" + fname, *(*t.generics)[0], o);
+		o << "\t}" << '\n';
+	};
+	if (!size_constant(*(*t.generics)[0], o, [&](const string& v) { return "if (" + fname + ") __pm.size += " + v + ";"; }, each))
+		each();
+}
+
+void h_optional(const string& fname, const NType& t, ostream& o) {
+	const NType& v_t = *(*t.generics)[0];
+	if (!owns_heap(&v_t)) return;
+	ostringstream body;
+	heap_value("__o_" + fname, v_t, body);
+	if (body.str().empty()) return;
+	o << "\tif (" << fname << ") {" << '\n'
+		<< "\tconst auto& __o_" << fname << " = *" << fname << ";" << '\n'
+		<< body.str()
+		<< "\t}" << '\n';
+}
+
+void r_optional(const string& fname, const NType& t, ostream& o) {
+	o << "\t\t\tbool __h_" << fname << "; __s >> __h_" << fname << ";" << '\n'
+		<< "\t\t\tif (!__h_" << fname << ") " << fname << ".reset();" << '\n'
+		<< "\t\t\telse {" << '\n'
+		<< "\t\t\tauto& __o_" << fname << " = " << fname << ".emplace();" << '\n';
+	deserialize_value("__o_" + fname, *(*t.generics)[0], o);
+	o << "\t\t\t}" << '\n';
+}
+
+// variants are tagged with the index of the active alternative
+void w_variant(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	o << "\t__s << " << fname << ".index() << ' ';" << '\n'
+		<< "\tswitch (" << fname << ".index()) {" << '\n';
+	for (size_t i = 0; i < list.size(); i++) {
+		o << "\tcase " << i << ": {" << '\n'
+			<< "\tconst auto& __a_" << fname << " = get<" << i << ">(" << fname << ");" << '\n';
+		serialize_value("__a_" + fname, *list[i], o);
+		o << "\tbreak; }" << '\n';
+	}
+	o << "\t}" << '\n';
+}
+
+void s_variant(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	o << "\t__pm.size += __as_digits(" << fname << ".index()) + 1;" << '\n'
+		<< "\tswitch (" << fname << ".index()) {" << '\n';
+	for (size_t i = 0; i < list.size(); i++) {
+		o << "\tcase " << i << ": {" << '\n'
+			<< "\tconst auto& __a_" << fname << " = get<" << i << ">(" << fname << ");" << '\n';
+		size_value("__a_" + fname, *list[i], o);
+		o << "\tbreak; }" << '\n';
+	}
+	o << "\t}" << '\n';
+}
+
+void h_variant(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	if (all_of(list.begin(), list.end(), [](const NType* a_t) { return !owns_heap(a_t); })) return;
+	o << "\tswitch (" << fname << ".index()) {" << '\n';
+	for (size_t i = 0; i < list.size(); i++) {
+		if (!owns_heap(list[i])) continue;
+		o << "\tcase " << i << ": {" << '\n'
+			<< "\tconst auto& __a_" << fname << " = get<" << i << ">(" << fname << ");" << '\n';
+		heap_value("__a_" + fname, *list[i], o);
+		o << "\tbreak; }" << '\n';
+	}
+	o << "\t}" << '\n';
+}
+
+void r_variant(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	o << "\t\t\tsize_t __n_" << fname << "; __s >> __n_" << fname << ";" << '\n'
+		<< "\t\t\tswitch (__n_" << fname << ") {" << '\n';
+	for (size_t i = 0; i < list.size(); i++) {
+		o << "\t\t\tcase " << i << ": {" << '\n'
+			<< "\t\t\tauto& __a_" << fname << " = " << fname << ".emplace<" << i << ">();" << '\n';
+		deserialize_value("__a_" + fname, *list[i], o);
+		o << "\t\t\tbreak; }" << '\n';
+	}
+	o << "\t\t\tdefault: if (__e(__AS_CTX \"." << fname << ": variant index out of range: \" + to_string(__n_" << fname << "))) return 0;" << '\n'
+		<< "\t\t\t}" << '\n';
+}
+
+// used for both `std::pair` and `std::tuple`
+void w_tuple(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	for (size_t i = 0; i < list.size(); i++) {
+		const string e_name = "__t" + to_string(i) + "_" + fname;
+		o << "\tconst auto& " << e_name << " = get<" << i << ">(" << fname << ");" << '\n';
+		serialize_value(e_name, *list[i], o);
+		o << "\t__s << ' ';" << '\n';
+	}
+}
+
+void s_tuple(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	o << "\t__pm.size += " << list.size() << ";" << '\n';
+	for (size_t i = 0; i < list.size(); i++) {
+		const string e_name = "__t" + to_string(i) + "_" + fname;
+		o << "\tconst auto& " << e_name << " = get<" << i << ">(" << fname << ");" << '\n';
+		size_value(e_name, *list[i], o);
+	}
+}
+
+void h_tuple(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	for (size_t i = 0; i < list.size(); i++) {
+		if (!owns_heap(list[i])) continue;
+		const string e_name = "__t" + to_string(i) + "_" + fname;
+		o << "\tconst auto& " << e_name << " = get<" << i << ">(" << fname << ");" << '\n';
+		heap_value(e_name, *list[i], o);
+	}
+}
+
+void r_tuple(const string& fname, const NType& t, ostream& o) {
+	const GenericsList& list = *t.generics;
+	for (size_t i = 0; i < list.size(); i++) {
+		const string e_name = "__t" + to_string(i) + "_" + fname;
+		o << "\t\t\tauto& " << e_name << " = get<" << i << ">(" << fname << ");" << '\n';
+		deserialize_value(e_name, *list[i], o);
+	}
+}
+
+// pointers used as arrays: `*[]<type,length>`, where `length` is an expression (usually another field)
+void w_pointer_array(const string& fname, const NType& t, ostream& o) {
+	const NType* e_t = (*t.generics)[0];
+	const string length = length_of(t);
+	o << "\tconst size_t __" << fname << "_sz = " << fname << " ? (size_t) (" << length << ") : 0;" << '\n'
+		<< "\t__s << __" << fname << "_sz << ' ';" << '\n';
+	if (find_type_pair(e_t).native) {
+		// native values are written as a single block of raw memory
+		write_block(fname, fname, "__" + fname + "_sz * sizeof(" + to_cpp_type(*e_t) + ")", o);
+	} else {
+		o << _GENERATE_FOR
+			<< "\tconst auto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << '\n';
+		serialize_value("__e_" + fname, *e_t, o);
+		o << "\t__s << ' ';" << '\n';
+		yield_point(o);
+		o << "\t}" << '\n';
+	}
+}
+
+void s_pointer_array(const string& fname, const NType& t, ostream& o) {
+	const NType* e_t = (*t.generics)[0];
+	const string length = length_of(t);
+	o << "\tconst size_t __" << fname << "_sz = " << fname << " ? (size_t) (" << length << ") : 0;" << '\n'
+		<< "\t__pm.size += __as_digits(__" << fname << "_sz) + 1;" << '\n';
+	if (find_type_pair(e_t).native) {
+		o << "\t__pm.size += __" << fname << "_sz * sizeof(" << to_cpp_type(*e_t) << ");" << '\n';
+	} else {
+		o << _GENERATE_FOR
+			<< "\tconst auto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << '\n';
+		size_value("__e_" + fname, *e_t, o);
+		o << "\t__pm.size += 1;" << '\n'
+			<< "\t}" << '\n';
+	}
+}
+
+void h_pointer_array(const string& fname, const NType& t, ostream& o) {
+	const NType* e_t = (*t.generics)[0];
+	const string length = length_of(t);
+	o << "\tif (__pm.first(" << fname << ")) {" << '\n'
+		<< "\tconst size_t __" << fname << "_sz = (size_t) (" << length << ");" << '\n'
+		<< "\t__pm.bytes += __" << fname << "_sz * sizeof(" << to_cpp_type(*e_t) << ");" << '\n';
+	if (owns_heap(e_t)) {
+		o << _GENERATE_FOR
+			<< "\tconst auto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << '\n';
+		heap_value("__e_" + fname, *e_t, o);
+		o << "\t}" << '\n';
+	}
+	o << "\t}" << '\n';
+}
+
+void r_pointer_array(const string& fname, const NType& t, ostream& o) {
+	const NType* e_t = (*t.generics)[0];
+	const string e_cpp = to_cpp_type(*e_t);
+	/* the buffer is allocated at once, the length field is read independently:
+	 * the struct checks that they agree once every field is read (not in columns) */
+	o << "\t\t\tsize_t __" << fname << "_sz; __s >> __" << fname << "_sz;" << '\n'
+		<< "\t\t\t__s.ignore(1);" << '\n' // skip the whitespace separator
+		<< "\t\t\t" << fname << " = __" << fname << "_sz ? new " << e_cpp << "[__" << fname << "_sz] : nullptr;" << '\n';
+	if (element_scope.empty() && !length_field(t).empty())
+		o << "\t\t\t__pm.arrays.push_back({ &" << fname << ", __" << fname << "_sz });" << '\n';
+	if (find_type_pair(e_t).native) {
+		o << "\t\t\t__s.read((char*) " << fname << ", __" << fname << "_sz * sizeof(" << e_cpp << "));" << '\n'
+			<< "\t\t\tif (__s.fail()) if (__e(__AS_CTX \"." << fname << ": expected \" + to_string(__" << fname << "_sz) + \" values, but reading failed\")) return 0;" << '\n';
+	} else {
+		o << "\t\t" << _GENERATE_FOR
+			<< "\t\t\tauto& __e_" << fname << " = " << fname << "[__i_" << fname << "];" << '\n';
+		deserialize_value("__e_" + fname, *e_t, o);
+		o << "\t\t\t}" << '\n';
+	}
+}
+
+/* vectors of structs written column by column: `columnar<std::vector<type>>`.
+ * the struct writes every field for all the elements at once, see `serialize_column` */
+const NType* columnar_element(const NType& t) {
+	const NType* e_t = (*(*t.generics)[0]->generics)[0];
+	if (&find_type_pair(e_t) != &rw_object)
+		throw runtime_error("@columnar expects a vector of serializable structs, but got: " + to_string(t));
+	return e_t;
+}
+
+void w_columnar(const string& fname, const NType& t, ostream& o) {
+	const string e_cpp = to_cpp_type(*columnar_element(t));
+	o << "\t__s << " << fname << ".size() << ' ';" << '\n';
+	if (async_mode)
+		o << "\tco_await " << e_cpp << "::_serialize_columns_async(__w, __pm, ";
+	else
+		o << "\t" << e_cpp << "::_serialize_columns(__s, __pm, ";
+	o << "(const char*) " << fname << ".data(), sizeof(" << e_cpp << "), " << fname << ".size());" << '\n';
+}
+
+void r_columnar(const string& fname, const NType& t, ostream& o) {
+	const string e_cpp = to_cpp_type(*columnar_element(t));
+	o << "\t\t\tsize_t __" << fname << "_sz; __s >> __" << fname << "_sz;" << '\n'
+		<< "\t\t\t" << fname << ".resize(__" << fname << "_sz);" << '\n'
+		<< "\t\t\tif (!" << e_cpp << "::_deserialize_columns(__s, __e, __pm, (char*) " << fname << ".data(), sizeof(" << e_cpp << "), __" << fname << "_sz)) return 0;" << '\n';
+}
+
+void s_columnar(const string& fname, const NType& t, ostream& o) {
+	const string e_cpp = to_cpp_type(*columnar_element(t));
+	o << "\t__pm.size += __as_digits(" << fname << ".size()) + 1;" << '\n'
+		<< "\t" << e_cpp << "::_serialized_size_columns(__pm, (const char*) " << fname << ".data(), sizeof(" << e_cpp << "), " << fname << ".size());" << '\n';
+}
+
+void h_columnar(const string& fname, const NType& t, ostream& o) {
+	heap_value(fname, *(*t.generics)[0], o);
+}
+
+string length_field(const NType& t) {
+	if (t.name->value != "*[]") return "";
+	const string length = to_cpp_type(*(*t.generics)[1]);
+	bool is_field = !length.empty() && (isalpha(length[0]) || length[0] == '_')
+		&& length.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") == string::npos;
+	return is_field ? length : "";
+}
+
+string length_of(const NType& t) {
+	const string field = length_field(t);
+	return field.empty() ? to_cpp_type(*(*t.generics)[1]) : element_scope + field;
+}
+
+// generates a loop over the `__n` elements starting at `__first`, every `__stride` bytes
+void in_element(const string& st_name, bool is_const, const string& indent, ostream& o, const function<void()>& body) {
+	const string cnst = is_const ? "const " : "";
+	o << indent << "for (size_t __i = 0; __i < __n; __i++) {" << '\n'
+		<< indent << cnst << st_name << "& __el = *(" << cnst << st_name << "*) (__first + __i * __stride);" << '\n';
+	element_scope = "__el.";
+	body();
+	element_scope = "";
+	o << indent << "}" << '\n';
+}
+
+/* a field of many elements: name and type once, then all the values.
+ * native values are written as a single block of raw memory, copied through the scratch memory of the state */
+void serialize_column(const string& st_name, const string& fname, const NType& t, ostream& o) {
+	const NType* real_t = &t;
+	const rw_pair& pair = find_type_pair(real_t);
+	o << "\t__s << \"" << field_preface(fname, *real_t) << "\";" << '\n';
+	if (pair.native) {
+		const string cpp = "decltype(" + st_name + "::" + fname + ")";
+		o << "\t{" << '\n'
+			<< "\tchar* __c_" << fname << " = __pm.scratch_for(__n * sizeof(" << cpp << "));" << '\n';
+		in_element(st_name, true, "\t", o, [&]() {
+			o << "\tmemcpy(__c_" << fname << " + __i * sizeof(" << cpp << "), &__el." << fname << ", sizeof(" << cpp << "));" << '\n';
+		});
+		write_block(fname, "__c_" + fname, "__n * sizeof(" + cpp + ")", o);
+		o << "\t}" << '\n';
+	} else {
+		in_element(st_name, true, "\t", o, [&]() {
+			o << "\tconst auto& " << fname << " = __el." << fname << ";" << '\n';
+			serialize_value(fname, *real_t, pair, o);
+			o << "\t__s << ' ';" << '\n';
+			yield_point(o);
+		});
+	}
+	o << "\t__s << \"\\n\";" << '\n';
+}
+
+void deserialize_column(const string& st_name, const string& fname, const NType& t, ostream& o) {
+	const NType* real_t = &t;
+	const rw_pair& pair = find_type_pair(real_t);
+	o << "\t\t\t__TYPE_CHK(\"" << *real_t << "\");" << '\n';
+	if (pair.native) {
+		const string cpp = "decltype(" + st_name + "::" + fname + ")";
+		o << "\t\t\t__s.ignore(1);" << '\n' // skip the whitespace separator
+			<< "\t\t\tchar* __c_" << fname << " = __pm.scratch_for(__n * sizeof(" << cpp << "));" << '\n'
+			<< "\t\t\t__s.read(__c_" << fname << ", __n * sizeof(" << cpp << "));" << '\n'
+			<< "\t\t\tif (__s.fail()) if (__e(__AS_CTX \"." << fname << ": expected \" + to_string(__n) + \" values, but reading failed\")) return 0;" << '\n';
+		in_element(st_name, false, "\t\t\t", o, [&]() {
+			o << "\t\t\tmemcpy(&__el." << fname << ", __c_" << fname << " + __i * sizeof(" << cpp << "), sizeof(" << cpp << "));" << '\n';
+		});
+	} else {
+		in_element(st_name, false, "\t\t\t", o, [&]() {
+			o << "\t\t\tauto& " << fname << " = __el." << fname << ";" << '\n';
+			deserialize_value(fname, *real_t, pair, o);
+		});
+	}
+}
+
+void size_column(const string& st_name, const string& fname, const NType& t, ostream& o) {
+	const NType* real_t = &t;
+	const rw_pair& pair = find_type_pair(real_t);
+	o << "\t__pm.size += " << field_preface(fname, *real_t).size() + 1 << ";" << '\n';
+	if (pair.native) {
+		o << "\t__pm.size += __n * sizeof(decltype(" << st_name << "::" << fname << "));" << '\n';
+		return;
+	}
+	const auto each = [&]() {
+		in_element(st_name, true, "\t", o, [&]() {
+			o << "\tconst auto& " << fname << " = __el." << fname << ";" << '\n';
+			pair.size(fname, *real_t, o);
+			o << "\t__pm.size += 1;" << '\n';
+		});
+	};
+	if (!size_constant(*real_t, o, [&](const string& v) { return "__pm.size += __n * (" + v + " + 1);"; }, each))
+		each();
+}
+
+// a field whose strings are written once per call: `dict<type>`
+void w_dict(const string& fname, const NType& t, ostream& o) {
+	dict_mode = true;
+	serialize_value(fname, *(*t.generics)[0], o);
+	dict_mode = false;
+}
+
+void r_dict(const string& fname, const NType& t, ostream& o) {
+	dict_mode = true;
+	deserialize_value(fname, *(*t.generics)[0], o);
+	dict_mode = false;
+}
+
+void s_dict(const string& fname, const NType& t, ostream& o) {
+	dict_mode = true;
+	size_value(fname, *(*t.generics)[0], o);
+	dict_mode = false;
+}
+
+// strings are counted as usual, shared ones once
+void h_dict(const string& fname, const NType& t, ostream& o) {
+	heap_value(fname, *(*t.generics)[0], o);
+}
+
+/* integers written in `bits` bits, as hex digits: `packed<type,bits>` for `@bits(bits)`, where signed types
+ * keep their sign, and `packed<type,lo,hi>` for `@range(lo,hi)`, where the bits hold `value - lo`.
+ * containers of integers are packed densely, consecutive fields are packed together (see `output_field`) */
+struct packing {
+	const NType* value_t; // the type of the values, for the casts
+	bool container, resizable;
+	unsigned bits;
+	uint64_t lo, span; // modulo 2^64, the values go from `lo` to `lo + span`
+	bool checked; // some bit patterns are out of range
+	bool ranged; // `@range`, else `@bits`
+};
+
+packing packing_of(const NType& t) {
+	packing p;
+	const NType* inner = (*t.generics)[0];
+	const NType* real_t = inner;
+	find_type_pair(real_t);
+	const string& n = real_t->name->value;
+	p.resizable = !real_t->isArray && (n == "std::vector" || n == "vector");
+	p.container = p.resizable || real_t->isArray || n == "std::array" || n == "array";
+	p.value_t = p.container ? (*real_t->generics)[0] : inner;
+	const NType* value_real_t = p.value_t;
+	const rw_pair& pair = find_type_pair(value_real_t);
+	const string& vn = value_real_t->name->value;
+	if (value_real_t->isArray || !pair.native || vn == "float" || vn == "double")
+		throw runtime_error("@bits and @range expect integers, or containers of integers, but got: " + to_string(*inner));
+	try {
+		p.ranged = t.generics->size() == 3;
+		if (!p.ranged) {
+			p.bits = stoul(to_string(*(*t.generics)[1]));
+			if (p.bits == 0 || p.bits > 64) throw invalid_argument("bits");
+			p.span = p.bits == 64 ? ~0ull : (1ull << p.bits) - 1;
+			const bool is_signed = vn != "bool" && vn[0] != 'u'; // `uint8_t`, `unsigned int`...
+			p.lo = is_signed ? 0 - (p.span / 2 + 1) : 0;
+			p.checked = false;
+		} else {
+			int64_t lo = stoll(to_string(*(*t.generics)[1])), hi = stoll(to_string(*(*t.generics)[2]));
+			if (hi < lo) throw invalid_argument("range");
+			p.lo = lo;
+			p.span = (uint64_t) hi - p.lo;
+			for (p.bits = 1; p.bits < 64 && (p.span >> p.bits); p.bits++);
+			p.checked = p.bits < 64 && p.span != (1ull << p.bits) - 1;
+		}
+	} catch (const logic_error&) {
+		throw runtime_error("invalid @bits or @range arguments in: " + to_string(t));
+	}
+	return p;
+}
+
+// adds `lo` (or subtracts it, with `sign = -1`) modulo 2^64
+string add_lo(const packing& p, int sign) {
+	if (!p.lo) return "";
+	const bool negative = (int64_t) p.lo < 0;
+	return string(negative == (sign < 0) ? " + " : " - ") + to_string(negative ? 0 - p.lo : p.lo) + "ull";
+}
+
+// adds the value `expr` to the bit writer `__b`, values which don't fit make the stream fail
+void put_packed(const packing& p, const string& expr, const string& indent, ostream& o) {
+	const string bits = "(uint64_t) (" + expr + ")" + add_lo(p, -1);
+	if (p.span != ~0ull)
+		o << indent << "if (" << bits << " > " << p.span << "ull) __s.setstate(ios::failbit);" << '\n';
+	o << indent << "__b.put(" << bits << ", " << p.bits << ");" << '\n';
+}
+
+// reads a value from the bit reader `__b` into `target`
+void get_packed(const packing& p, const string& fname, const string& target, const string& indent, ostream& o) {
+	o << indent << "{" << '\n'
+		<< indent << "uint64_t __p = __b.get(" << p.bits << ");" << '\n';
+	if (p.checked)
+		o << indent << "if (__p > " << p.span << "ull) if (__e(__AS_CTX \"." << fname << ": value out of range\")) return 0;" << '\n';
+	o << indent << target << " = (" << to_cpp_type(*p.value_t) << ") (int64_t) (__p" << add_lo(p, 1) << ");" << '\n'
+		<< indent << "}" << '\n';
+}
+
+void w_packed(const string& fname, const NType& t, ostream& o) {
+	const packing p = packing_of(t);
+	o << "\t{" << '\n';
+	if (p.container)
+		o << "\t__s << std::size(" << fname << ") << ' ';" << '\n';
+	o << "\t__as_bit_writer __b(__s);" << '\n';
+	if (p.container) {
+		o << "\tfor (const auto& __x : " << fname << ") {" << '\n';
+		put_packed(p, "__x", "\t\t", o);
+		yield_point(o); // the bit writer passes its digits on every few bytes
+		o << "\t}" << '\n';
+	} else {
+		put_packed(p, fname, "\t", o);
+	}
+	o << "\t__b.finish();" << '\n'
+		<< "\t}" << '\n';
+}
+
+void r_packed(const string& fname, const NType& t, ostream& o) {
+	const packing p = packing_of(t);
+	if (p.container) {
+		o << "\t\t\tsize_t __k_" << fname << "; __s >> __k_" << fname << ";" << '\n';
+		if (p.resizable)
+			o << "\t\t\t" << fname << ".resize(__k_" << fname << ");" << '\n';
+		else
+			o << "\t\t\tif (__k_" << fname << " != std::size(" << fname << ")) if (__e(__AS_CTX \"." << fname << ": read \" + to_string(__k_" << fname
+				<< ") + \" values, expected \" + to_string(std::size(" << fname << ")))) return 0;" << '\n';
+	}
+	o << "\t\t\t{" << '\n'
+		<< "\t\t\t__as_bit_reader __b(__s);" << '\n';
+	if (p.container) {
+		o << "\t\t\tfor (auto&& __x : " << fname << ")" << '\n';
+		get_packed(p, fname, "__x", "\t\t\t", o);
+	} else {
+		get_packed(p, fname, fname, "\t\t\t", o);
+	}
+	o << "\t\t\t}" << '\n'
+		<< "\t\t\tif (__s.fail()) if (__e(__AS_CTX \"." << fname << ": reading the packed values failed\")) return 0;" << '\n';
+}
+
+void s_packed(const string& fname, const NType& t, ostream& o) {
+	const packing p = packing_of(t);
+	if (p.container)
+		o << "\t__pm.size += __as_digits(std::size(" << fname << ")) + 1 + (std::size(" << fname << ") * " << p.bits << " + 3) / 4;" << '\n';
+	else
+		o << "\t__pm.size += " << (p.bits + 3) / 4 << ";" << '\n';
+}
+
+// a single value has a constant length
+constant_length c_packed(const NType& t) {
+	const packing p = packing_of(t);
+	if (p.container) return {};
+	return { to_string((p.bits + 3) / 4) };
+}
+
+// the values are kept unpacked in memory
+void h_packed(const string& fname, const NType& t, ostream& o) {
+	heap_value(fname, *(*t.generics)[0], o);
+}
+
+bool is_packed_scalar(const NType& t) {
+	return t.name->value == "packed" && !packing_of(t).container;
+}
+
+string output_field::name() const {
+	string res;
+	for (const NVarDeclaration* d : decls)
+		res += (res.empty() ? "" : "+") + d->name->value;
+	return res;
+}
+
+// packed fields are written together, as in: `a+b+c bits<1,3,12> 1f02`
+string packed_preface(const output_field& f, size_t& bits) {
+	string widths;
+	bits = 0;
+	for (const NVarDeclaration* d : f.decls) {
+		const unsigned b = packing_of(*d->completeType).bits;
+		widths += (widths.empty() ? "" : ",") + to_string(b);
+		bits += b;
+	}
+	return f.name() + " bits<" + widths + "> ";
+}
+
+void serialize_field(const output_field& f, ostream& o) {
+	if (!f.packed) return serialize_field(f.decls[0]->name->value, *f.decls[0]->completeType, o);
+	size_t bits;
+	o << "\t__s << \"" << packed_preface(f, bits) << "\";" << '\n'
+		<< "\t{" << '\n'
+		<< "\t__as_bit_writer __b(__s);" << '\n';
+	for (const NVarDeclaration* d : f.decls)
+		put_packed(packing_of(*d->completeType), d->name->value, "\t", o);
+	o << "\t__b.finish();" << '\n'
+		<< "\t}" << '\n'
+		<< "\t__s << \"\\n\";" << '\n';
+}
+
+void size_field(const output_field& f, ostream& o) {
+	if (!f.packed) return size_field(f.decls[0]->name->value, *f.decls[0]->completeType, o);
+	size_t bits;
+	const size_t preface = packed_preface(f, bits).size();
+	o << "\t__pm.size += " << preface + (bits + 3) / 4 + 1 << ";" << '\n';
+}
+
+void deserialize_field(const output_field& f, ostream& o) {
+	if (!f.packed) return deserialize_field(f.decls[0]->name->value, *f.decls[0]->completeType, o);
+	size_t bits;
+	const string preface = packed_preface(f, bits);
+	o << "\t\t\t__TYPE_CHK(\"" << preface.substr(f.name().size() + 1, preface.size() - f.name().size() - 2) << "\");" << '\n'
+		<< "\t\t\t__as_bit_reader __b(__s);" << '\n';
+	for (const NVarDeclaration* d : f.decls)
+		get_packed(packing_of(*d->completeType), d->name->value, "__v." + d->name->value, "\t\t\t", o);
+	o << "\t\t\tif (__s.fail()) if (__e(__AS_CTX \"." << f.name() << ": reading the packed values failed\")) return 0;" << '\n';
+}
+
+// in columns, the packed fields of all the elements are packed together
+void serialize_column(const string& st_name, const output_field& f, ostream& o) {
+	if (!f.packed) return serialize_column(st_name, f.decls[0]->name->value, *f.decls[0]->completeType, o);
+	size_t bits;
+	o << "\t__s << \"" << packed_preface(f, bits) << "\";" << '\n'
+		<< "\t{" << '\n'
+		<< "\t__as_bit_writer __b(__s);" << '\n';
+	in_element(st_name, true, "\t", o, [&]() {
+		for (const NVarDeclaration* d : f.decls)
+			put_packed(packing_of(*d->completeType), "__el." + d->name->value, "\t", o);
+		yield_point(o);
+	});
+	o << "\t__b.finish();" << '\n'
+		<< "\t}" << '\n'
+		<< "\t__s << \"\\n\";" << '\n';
+}
+
+void deserialize_column(const string& st_name, const output_field& f, ostream& o) {
+	if (!f.packed) return deserialize_column(st_name, f.decls[0]->name->value, *f.decls[0]->completeType, o);
+	size_t bits;
+	const string preface = packed_preface(f, bits);
+	o << "\t\t\t__TYPE_CHK(\"" << preface.substr(f.name().size() + 1, preface.size() - f.name().size() - 2) << "\");" << '\n'
+		<< "\t\t\t__as_bit_reader __b(__s);" << '\n';
+	in_element(st_name, false, "\t\t\t", o, [&]() {
+		for (const NVarDeclaration* d : f.decls)
+			get_packed(packing_of(*d->completeType), d->name->value, "__el." + d->name->value, "\t\t\t", o);
+	});
+	o << "\t\t\tif (__s.fail()) if (__e(__AS_CTX \"." << f.name() << ": reading the packed values failed\")) return 0;" << '\n';
+}
+
+void size_column(const string& st_name, const output_field& f, ostream& o) {
+	if (!f.packed) return size_column(st_name, f.decls[0]->name->value, *f.decls[0]->completeType, o);
+	size_t bits;
+	const size_t preface = packed_preface(f, bits).size();
+	o << "\t__pm.size += " << preface + 1 << " + (__n * " << bits << " + 3) / 4;" << '\n';
 }
 
 // forward declared at the beginning of the file
-rw_pair rw_object = _P(object);
-rw_pair rw_static_array = _P(static_array);
+rw_pair rw_object = _PC(object);
+rw_pair rw_static_array = _PC(static_array);
 
 // shortcut macros for accessing `type_map`
 #define _T(x) types_map[#x]
@@ -243,34 +1514,47 @@ rw_pair rw_static_array = _P(static_array);
 #define _US_T(x) _T(u ## x) = _T(unsigned x) // `uint` and `unsigned int`
 
 void init_types() {
-	_T(bool) = _P(bool);
-	_T(char) = _P(int8_t);
-	_US_T(char) = _P(uint8_t);
-	_T(int8_t) = _P(int8_t);
-	_T(int16_t) = _P(int16_t);
-	_T(int32_t) = _P(int32_t);
-	_T(int64_t) = _P(int64_t);
-	_T(uint8_t) = _P(uint8_t);
-	_T(uint16_t) = _P(uint16_t);
-	_T(uint32_t) = _P(uint32_t);
-	_T(uint64_t) = _P(uint64_t);
-	_T(int) = sizeof(int) == 4 ? _P(int32_t) : _P(int16_t);
-	_US_T(int) = sizeof(int) == 4 ? _P(uint32_t) : _P(uint16_t);
-	_T(long) = sizeof(long) == 8 ? _P(int64_t) : _P(int32_t);
-	_US_T(long) = sizeof(long) == 4 ? _P(uint64_t) : _P(uint32_t);
-	_T(long long) = _P(int64_t);
-	_US_T(long long) = _P(uint64_t);
-	_T(float) = _P(float);
-	_T(double) = _P(double);
+	_T(bool) = _PN(bool);
+	_T(char) = _PN(int8_t);
+	_US_T(char) = _PN(uint8_t);
+	_T(int8_t) = _PN(int8_t);
+	_T(int16_t) = _PN(int16_t);
+	_T(int32_t) = _PN(int32_t);
+	_T(int64_t) = _PN(int64_t);
+	_T(uint8_t) = _PN(uint8_t);
+	_T(uint16_t) = _PN(uint16_t);
+	_T(uint32_t) = _PN(uint32_t);
+	_T(uint64_t) = _PN(uint64_t);
+	_T(int) = sizeof(int) == 4 ? _PN(int32_t) : _PN(int16_t);
+	_US_T(int) = sizeof(int) == 4 ? _PN(uint32_t) : _PN(uint16_t);
+	_T(long) = sizeof(long) == 8 ? _PN(int64_t) : _PN(int32_t);
+	_US_T(long) = sizeof(long) == 4 ? _PN(uint64_t) : _PN(uint32_t);
+	_T(long long) = _PN(int64_t);
+	_US_T(long long) = _PN(uint64_t);
+	_T(float) = _PN(float);
+	_T(double) = _PN(double);
 	_T(*) = _P(pointer); // pointers are saved like: int* --> *<int>
+	_T(*[]) = _P(pointer_array); // pointers used as arrays: int* p @length(n) --> *[]<int,n>
 	_STD_T(string) = _P(string);
-	_STD_T(vector) = _STD_T(set) = _STD_T(unordered_set) = _P(vector);
+	_STD_T(vector) = _STD_T(deque) = _STD_T(set) = _STD_T(unordered_set) = _P(vector);
 	_STD_T(map) = _STD_T(unordered_map) = _P(map);
+	_STD_T(array) = _PC(std_array);
+	_STD_T(pair) = _STD_T(tuple) = _P(tuple);
+	_STD_T(optional) = _P(optional);
+	_STD_T(variant) = _P(variant);
+	_STD_T(unique_ptr) = _P(unique_ptr);
+	_STD_T(shared_ptr) = _P(shared_ptr);
+	_T(columnar) = _P(columnar); // std::vector<st> v @columnar --> columnar<std::vector<st>>
+	_T(lazy) = _P(lazy); // st* p @lazy --> lazy<st>
+	_T(dict) = _P(dict); // std::vector<std::string> v @dict --> dict<std::vector<std::string>>
+	_T(packed) = _PC(packed); // int x @bits(3) --> packed<int,3>, int y @range(1,6) --> packed<int,1,6>
 }
 
 void add_alias(const segment_t pos, const string& name, const NType* real) {
 	auto itr = alias_map.find(name);
 	if (itr != alias_map.end())
 		throw runtime_error("at " + to_string(pos) + ": redeclaration of alias " + name);
+	find_type_pair(real); // chains of aliases are followed only once
 	alias_map[name] = real;
+	resolved_types.clear();
 }
@@ -3,12 +3,14 @@
 #include <pos_t.hh>
 #include <iostream>
 #include <vector>
+#include <stdexcept>
 
 class NBodyElem;
 class NVarDeclaration;
 class NFunctionArg;
 class NType;
 class NParent;
+class NAnnotation;
 
 using VarDeclList = std::vector<NVarDeclaration*>;
 using TypeSuffixList = std::vector<int>;
@@ -16,6 +18,8 @@ using ArraySuffixList = std::vector<std::string*>;
 using GenericsList = std::vector<const NType*>;
 using BodyList = std::vector<NBodyElem*>;
 using ParentsList = std::vector<NParent*>;
+using AnnotationArgs = std::vector<std::string*>;
+using AnnotationList = std::vector<NAnnotation*>;
 
 // optionally deletes (if elem is not null)
 #define _OPT_DEL(elem) if (elem) delete elem;
@@ -24,11 +28,17 @@ using ParentsList = std::vector<NParent*>;
 // delete vector elements and the vector itself
 #define _DEL_VEC(vec) _DEL_ELEMS(*vec); delete vec;
 
+// nodes are allocated from an arena, and released all together when the generator exits
+void* ast_alloc(std::size_t size);
+
 class Node {
 public:
 	segment_t pos;
 	Node(segment_t p) : pos(p) {}
 	virtual ~Node() {}
+	// deleting a node only releases what it owns
+	static void* operator new(std::size_t size) { return ast_alloc(size); }
+	static void operator delete(void*) {}
 };
 
 class NBodyElem : public Node {
@@ -51,77 +61,111 @@ public:
 	virtual ~NIdentifier() {}
 };
 
+/* types are interned: equal types are the same object, so that they can be compared and hashed
+ * by address; they are never modified nor deleted, and keep the position of their first occurrence */
 class NType : public Node {
 public:
-	NIdentifier* name;
-	GenericsList* generics;
-	bool isArray = false; // true when `name` is the size of a static array
-	NType(segment_t p, NIdentifier* n, GenericsList* g)
-		: Node(p), name(n), generics(g) {}
-	virtual ~NType() { delete name; delete generics; }
-
-	NType* deepCopy() const {
-		GenericsList* l = new GenericsList();
-		for (const NType* child : *generics)
-			l->push_back(child->deepCopy());
-		std::string namecpy = name->value;
-		NIdentifier* idt = new NIdentifier(name->pos, std::move(namecpy));
-		return new NType(pos, idt, l);
+	const NIdentifier* name;
+	const GenericsList* generics;
+	const bool isArray; // true when `name` is the size of a static array
+	std::string internal, cpp; // the names returned by `to_string` and `to_cpp_type`
+
+	// the unique type with the given name and generics
+	static const NType* get(segment_t pos, std::string name, GenericsList generics = {}, bool isArray = false);
+	// same as above, releasing the parsed nodes
+	static const NType* get(segment_t pos, NIdentifier* name, GenericsList* generics) {
+		const NType* t = get(pos, std::move(name->value), std::move(*generics));
+		delete name; delete generics;
+		return t;
+	}
+
+	static const NType* pointerTo(const NType* obj, segment_t pos) {
+		return get(pos, "*", { obj });
+	}
+
+	static const NType* arrayOf(const NType* obj, const std::string* size, segment_t pos) {
+		return get(pos, *size, { obj }, true); // the identifier is the size, not the name
+	}
+
+	// pointer to the first element of `length` values: `*[]<type,length>`
+	static const NType* pointerArrayOf(const NType* ptr, const std::string* length, segment_t pos) {
+		return get(pos, "*[]", { (*ptr->generics)[0], get(pos, *length) });
+	}
+
+	// vector written column by column: `columnar<std::vector<type>>`
+	static const NType* columnarOf(const NType* vec, segment_t pos) {
+		return get(pos, "columnar", { vec });
 	}
 
-	static NType* pointerTo(NType* obj, segment_t pos) {
-		GenericsList* l = new GenericsList();
-		l->push_back(obj);
-		return new NType(pos, new NIdentifier(pos, "*"), l);
+	// field whose strings are written once per call: `dict<type>`
+	static const NType* dictOf(const NType* t, segment_t pos) {
+		return get(pos, "dict", { t });
 	}
 
-	static NType* arrayOf(NType* obj, std::string* size, segment_t pos) {
-		GenericsList* l = new GenericsList();
-		l->push_back(obj);
-		std::string size_cp = *size;
-		NType* r = new NType(pos, new NIdentifier(pos, std::move(size_cp)), l);
-		r->isArray = true; // the identifier is the size, not the name
-		return r;
+	// integers in few bits: `packed<type,bits>` or `packed<type,lo,hi>`
+	static const NType* packedOf(const NType* t, const AnnotationArgs& args, segment_t pos) {
+		GenericsList l = { t };
+		for (const std::string* a : args)
+			l.push_back(get(pos, *a));
+		return get(pos, "packed", std::move(l));
 	}
+
+	// pointer read on first access: `lazy<type>`
+	static const NType* lazyOf(const NType* ptr, segment_t pos) {
+		return get(pos, "lazy", { (*ptr->generics)[0] });
+	}
+
+private:
+	NType(segment_t p, NIdentifier* n, GenericsList* g, bool a)
+		: Node(p), name(n), generics(g), isArray(a) {}
 };
 
 // converts to the internal name format
-std::string to_string(const NType& t);
+const std::string& to_string(const NType& t);
 // converts to the C++ name format
-std::string to_cpp_type(const NType& t);
+const std::string& to_cpp_type(const NType& t);
 // converts to the internal name format
 std::ostream& operator<<(std::ostream& o, const NType& t);
-bool operator==(const NType& a, const NType& b);
-namespace std {
-template<>
-class hash<NType> {
+
+class NAnnotation : public Node {
 public:
-	size_t operator()(const NType& s) const;
+	NIdentifier* name;
+	AnnotationArgs* args;
+	NAnnotation(segment_t p, NIdentifier* n, AnnotationArgs* a)
+		: Node(p), name(n), args(a) {}
+	virtual ~NAnnotation() { delete name; _DEL_VEC(args); }
 };
-}
 
 class NVarDeclaration : public Node {
 public:
 	TypeSuffixList* tSuffixes;
 	NIdentifier* name;
 	ArraySuffixList* arraySuffixes;
+	AnnotationList* annotations;
 	std::string* assignment;
-	NType* completeType;
-	NVarDeclaration(segment_t p, TypeSuffixList* s, NIdentifier* n, ArraySuffixList* as, std::string* a)
-		: Node(p), tSuffixes(s), arraySuffixes(as), name(n), assignment(a) {}
-	virtual ~NVarDeclaration() { delete tSuffixes; delete name; _OPT_DEL(assignment); delete completeType; }
+	const NType* completeType = nullptr;
+	NVarDeclaration(segment_t p, TypeSuffixList* s, NIdentifier* n, ArraySuffixList* as, AnnotationList* an, std::string* a)
+		: Node(p), tSuffixes(s), arraySuffixes(as), name(n), annotations(an), assignment(a) {}
+	virtual ~NVarDeclaration() { delete tSuffixes; delete name; _DEL_VEC(annotations); _OPT_DEL(assignment); }
+
+	// returns nullptr if the field has no such annotation
+	const NAnnotation* findAnnotation(const std::string& aname) const {
+		for (const NAnnotation* a : *annotations)
+			if (a->name->value == aname) return a;
+		return nullptr;
+	}
 };
 
 class NVarBlock : public NBodyElem {
 public:
-	NType* type;
+	const NType* type;
 	VarDeclList* vars;
 
-	NVarBlock(segment_t p, NType* type, VarDeclList* vars)
+	NVarBlock(segment_t p, const NType* type, VarDeclList* vars)
 		: NBodyElem(p), type(type), vars(vars) {
 		// complete type: int* --> *<int> and int* a, b --> *<int> a; int b
 		for (NVarDeclaration* d : *vars) {
-			NType* ct = type->deepCopy();
+			const NType* ct = type;
 			for (int i = 0; i < d->tSuffixes->size(); i++)
 				ct = NType::pointerTo(ct, d->pos);
 			// loop backwards otherwise dimesntions will be inverted
@@ -129,10 +173,47 @@ public:
 				std::string* size = (*d->arraySuffixes)[i];
 				ct = NType::arrayOf(ct, size, d->pos);
 			}
+			// pointers used as arrays: float* data @length(n) --> *[]<float,n>
+			if (const NAnnotation* len = d->findAnnotation("length")) {
+				if (ct->isArray || ct->name->value != "*" || len->args->size() != 1)
+					throw std::runtime_error("at " + to_string(len->pos) + ": @length(<field>) expects a pointer field");
+				ct = NType::pointerArrayOf(ct, (*len->args)[0], len->pos);
+			}
+			// vectors of structs written column by column: std::vector<st> v @columnar --> columnar<std::vector<st>>
+			if (const NAnnotation* col = d->findAnnotation("columnar")) {
+				const std::string& n = ct->name->value;
+				if (ct->isArray || (n != "std::vector" && n != "vector") || ct->generics->size() != 1 || !col->args->empty())
+					throw std::runtime_error("at " + to_string(col->pos) + ": @columnar expects a std::vector field");
+				ct = NType::columnarOf(ct, col->pos);
+			}
+			// pointers read on first access: st* p @lazy --> lazy<st>
+			if (const NAnnotation* lazy = d->findAnnotation("lazy")) {
+				if (ct->isArray || ct->name->value != "*" || !lazy->args->empty())
+					throw std::runtime_error("at " + to_string(lazy->pos) + ": @lazy expects a pointer field");
+				ct = NType::lazyOf(ct, lazy->pos);
+			}
+			// integers in few bits: bool b @bits(1) --> packed<bool,1>, int x @range(-5,5) --> packed<int,-5,5>
+			const NAnnotation* bits = d->findAnnotation("bits");
+			const NAnnotation* range = d->findAnnotation("range");
+			if (bits && range)
+				throw std::runtime_error("at " + to_string(range->pos) + ": @bits and @range can't be used together");
+			if (bits && bits->args->size() != 1)
+				throw std::runtime_error("at " + to_string(bits->pos) + ": @bits(<bits>) expects the number of bits");
+			if (range && range->args->size() != 2)
+				throw std::runtime_error("at " + to_string(range->pos) + ": @range(<lo>,<hi>) expects the lowest and highest values");
+			if (bits || range)
+				ct = NType::packedOf(ct, *(bits ? bits : range)->args, (bits ? bits : range)->pos);
+			// strings written once per call: std::vector<std::string> v @dict --> dict<std::vector<std::string>>
+			if (const NAnnotation* dict = d->findAnnotation("dict")) {
+				const std::string& n = ct->name->value;
+				if (!dict->args->empty() || n == "lazy" || n == "columnar" || n == "packed")
+					throw std::runtime_error("at " + to_string(dict->pos) + ": @dict expects no arguments, and can't be used with @lazy, @columnar, @bits or @range");
+				ct = NType::dictOf(ct, dict->pos);
+			}
 			d->completeType = ct;
 		}
 	}
-	virtual ~NVarBlock() { delete type; _DEL_VEC(vars); }
+	virtual ~NVarBlock() { _DEL_VEC(vars); }
 };
 
 class NCode : public NRoot, public NBodyElem {
@@ -146,32 +227,32 @@ public:
 class NParent : public Node {
 public:
 	std::string *code_prev;
-	NType* type;
-	NParent(segment_t s, std::string* p, NType* t)
+	const NType* type;
+	NParent(segment_t s, std::string* p, const NType* t)
 		: Node(s), code_prev(p), type(t) {}
-	virtual ~NParent() { delete code_prev; delete type; }
+	virtual ~NParent() { delete code_prev; }
 };
 
 class NStruct : public NRoot {
 public:
 	bool isVirtual, isClass;
-	NType* name;
+	const NType* name;
 	ParentsList* parents;
 	std::string* code_parents;
 	BodyList* body;
-	NStruct(segment_t p, bool iv, bool ic, NType* n, ParentsList* e, std::string* c, BodyList* b)
+	NStruct(segment_t p, bool iv, bool ic, const NType* n, ParentsList* e, std::string* c, BodyList* b)
 		: NRoot(p), isVirtual(iv), isClass(ic), name(n), parents(e), code_parents(c), body(b) {}
-	virtual ~NStruct() { delete name; _DEL_VEC(parents); delete code_parents; _DEL_VEC(body); }
+	virtual ~NStruct() { _DEL_VEC(parents); delete code_parents; _DEL_VEC(body); }
 };
 
 class NPolymElem : public Node {
 public:
-	NType* type;
+	const NType* type;
 	bool includeLocal;
 	std::string* include;
-	NPolymElem(segment_t p, NType* t, bool l, std::string* i)
+	NPolymElem(segment_t p, const NType* t, bool l, std::string* i)
 		: Node(p), type(t), includeLocal(l), include(i) { }
-	virtual ~NPolymElem() { delete type; delete include; }
+	virtual ~NPolymElem() { delete include; }
 
 };
 
@@ -179,18 +260,18 @@ using PolymList = std::vector<NPolymElem*>;
 
 class NPolym : public NRoot {
 public:
-	NType* subject;
+	const NType* subject;
 	PolymList* children;
-	NPolym(segment_t p, NType* s, PolymList* c)
+	NPolym(segment_t p, const NType* s, PolymList* c)
 		: NRoot(p), subject(s), children(c) {}
-	virtual ~NPolym() { delete subject; _DEL_VEC(children); }
+	virtual ~NPolym() { _DEL_VEC(children); }
 };
 
 class NAlias : public NRoot {
 public:
 	bool in_code; // wheter it is only useful for the serializer if it goes in the real header
-	NType *name, *real;
-	NAlias(segment_t p, bool i, NType* n, NType* r)
+	const NType *name, *real;
+	NAlias(segment_t p, bool i, const NType* n, const NType* r)
 		: NRoot(p), in_code(i), name(n), real(r) {}
-	virtual ~NAlias() { delete name; delete real; }
+	virtual ~NAlias() { }
 };
@@ -0,0 +1,9 @@
+#pragma once
+#include <iosfwd>
+#include <string>
+
+// the name of the header with the support code, written next to the generated headers
+constexpr const char* runtime_header = "auto_serializer_runtime.hh";
+
+// writes the support code used by the generated headers next to `header`, and includes it from `hout`
+void emit_runtime(const std::string& header, std::ostream& hout);
@@ -1,10 +1,45 @@
 #pragma once
 
 #include <node.hh>
+#include <vector>
+
+// when set, the serialization code is generated for the coroutine-based serializer
+extern bool async_mode;
 
 void init_types();
 void add_alias(const segment_t pos, const std::string& name, const NType* real);
+// native values and static arrays of them, which can be copied as raw memory (resolves aliases)
+bool is_raw_type(const NType*& t);
+// values which can be compared with `==` and assigned, as needed by `@sparse`
+bool is_comparable_type(const NType* t);
+// structs whose objects can be written as raw memory, with the id of their layout
+void add_raw_struct(const std::string& name, const std::string& layout);
+// the length of an object written as raw memory
+std::string raw_struct_size(const std::string& name, const std::string& layout);
 
 void serialize_field(const std::string&, const NType&, std::ostream& o);
+void size_field(const std::string&, const NType&, std::ostream& o);
 void deserialize_field(const std::string&, const NType&, std::ostream& o);
+// `@columnar` vectors: a field of `__n` elements of the struct `st_name`
+void serialize_column(const std::string& st_name, const std::string& fname, const NType& t, std::ostream& o);
+void deserialize_column(const std::string& st_name, const std::string& fname, const NType& t, std::ostream& o);
+void size_column(const std::string& st_name, const std::string& fname, const NType& t, std::ostream& o);
 void deserialize_value(const std::string& fname, const NType& t, std::ostream& o);
+// the field giving the length of a pointer used as array (`@length(field)`), empty for other types and lengths
+std::string length_field(const NType& t);
+// adds the heap memory owned by the value to `__pm.bytes`, for `memory_footprint`
+void heap_value(const std::string& fname, const NType& t, std::ostream& o);
+
+// a field as written: a single field, or consecutive `@bits`/`@range` fields packed together
+struct output_field {
+	std::vector<const NVarDeclaration*> decls;
+	bool packed;
+	std::string name() const;
+};
+bool is_packed_scalar(const NType& t);
+void serialize_field(const output_field& f, std::ostream& o);
+void size_field(const output_field& f, std::ostream& o);
+void deserialize_field(const output_field& f, std::ostream& o);
+void serialize_column(const std::string& st_name, const output_field& f, std::ostream& o);
+void deserialize_column(const std::string& st_name, const output_field& f, std::ostream& o);
+void size_column(const std::string& st_name, const output_field& f, std::ostream& o);
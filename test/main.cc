@@ -1,23 +1,62 @@
+#define AS_RUNTIME_IO // for record logs and lazy files
 #include <types1.hh>
 #include <types2.hh>
 #include <types3.hh>
 #include <types4.hh>
 #include <types4a.hh>
 #include <types4b.hh>
+#include <types5.hh>
+#include <types6.hh>
+#include <types7.hh>
+#include <types8.hh>
+#include <types9.hh>
+#include <types10.hh>
+#include <types11.hh>
+#include <types12.hh>
+#include <types13.hh>
+#include <types14.hh>
 
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string_view>
+#include <atomic>
+#include <new>
 
 using namespace std;
 
 int mode = 0;
 
+// counts the heap allocations, to check the reuse of contexts
+atomic<size_t> allocations(0);
+void* operator new(size_t n) {
+	allocations++;
+	if (void* p = malloc(n ? n : 1)) return p;
+	throw bad_alloc();
+}
+// not inlined, so that the compiler doesn't see `free` called on the result of `new` (-Wmismatched-new-delete)
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
 template<typename T>
 int test_it(T& v) {
 	if (mode == 0) {
 		// test both serealization and deserialization, should produce identical outputs
 		stringstream ss;
 		v.serialize_to(ss);
+		// the computed size must be exact, and enough to serialize into a fixed buffer
+		const size_t size = v.serialized_size();
+		string buffer(size, '\0');
+		if (size != ss.str().size() || v.serialize_to(&buffer[0], size) != size || buffer != ss.str()) {
+			cerr << "serialized size: " << size << ", actual size: " << ss.str().size() << endl;
+			return 1;
+		}
+		if (v.serialize_to(&buffer[0], size - 1) != 0) return 1;
 		cout << "ORIG / " << &v << ": {{{" << endl << endl
 			<< ss.str() << endl
 			<< endl << "}}}" << endl << endl;
@@ -66,7 +105,7 @@ int test1() {
 	v.matrix = { { 3, 5, 6},
 				 { 6, 7, 7, 9 },
 				 { 3, 1, -3 } };
-	v.doubles = { 3.14, 6.28, 9.42 };
+	v.doubles = { 3.14, 6.28, 9.42, -0.0001, 1e-5, 123456, 1234567, 999999.5, 1e100 };
 	v.intToFloat = { {0, 1}, {1, 2.72}, {2, 7.39} };
 	v.ptr = new int;
 	*v.ptr = 1234321;
@@ -125,6 +164,826 @@ int test4() {
 	return test_it<st4>(v);
 }
 
+// std types and smart pointers test
+int test5() {
+	st5 v;
+	v.opt_full = "optional value";
+	v.var = std::vector<float>{ 1.5, 2.5 };
+	v.deq = { { 1, "one" }, { 2, "two" } };
+	v.tup = { 7, 0.125, "tuple" };
+	v.u_int.reset(new int(99));
+	v.u_base.reset(new child4a(555, "unique_a"));
+	auto leaf = std::make_shared<st5leaf>();
+	leaf->val = 42;
+	v.leaves = { leaf, leaf, std::make_shared<st5leaf>() };
+	v.s_str = std::make_shared<std::string>("shared string");
+
+	// the shared leaf must still be shared after a round trip
+	stringstream ss;
+	v.serialize_to(ss);
+	st5 w;
+	if (!w.deserialize_from(ss, [](const string& err) { cerr << err << endl; return true; }))
+		return 1;
+	if (w.leaves[0] != w.leaves[1] || w.leaves[0] == w.leaves[2] || w.leaves[0]->val != 42) {
+		cerr << "shared pointers were not shared after deserialization" << endl;
+		return 1;
+	}
+
+	return test_it<st5>(v);
+}
+
+// pointers used as arrays test
+int test6() {
+	st6 v;
+	v.n_values = 5;
+	v.values = new double[v.n_values] { 0.5, 1.5, -2.25, 1e10, 3 };
+	v.n_names = 3;
+	v.names = new std::string[v.n_names] { "first", "", "third name" };
+
+	if (mode != 0) return test_it<st6>(v);
+	if (int r = test_it<st6>(v)) return r;
+	// a length field which doesn't match the buffer read is reported
+	stringstream ss;
+	v.serialize_to(ss);
+	string out = ss.str();
+	const string length = "n_names uint32_t 3";
+	const size_t at = out.find(length);
+	if (at == string::npos) return 1;
+	out[at + length.size() - 1] = '9';
+	stringstream bad(out);
+	st6 w;
+	string error;
+	return w.deserialize_from(bad, [&](const string& err) { error = err; return true; }) || error.find("names: read 3 values") == string::npos;
+}
+
+// record log test: random access, appending, truncated tails
+int test7() {
+	const string path = "test_record_log.tmp";
+	remove(path.c_str());
+	auto error = [](const string& err) { cerr << "deserialization error: " << err << endl; return true; };
+	auto check = [&](size_t expected_size, bool expected_truncated) -> bool {
+		st1::record_log_reader r;
+		if (!r.open(path)) { cerr << "can't open the log" << endl; return false; }
+		if (r.size() != expected_size || r.truncated() != expected_truncated) {
+			cerr << "log has " << r.size() << " records, truncated: " << r.truncated() << endl;
+			return false;
+		}
+		st1 v;
+		if (!r.read(137, v, error) || v.b != 137) return false;
+		size_t count = 0;
+		bool values_ok = true;
+		bool ok = r.read_range(expected_size - 20, expected_size, [&](size_t i, st1& w) {
+			values_ok = values_ok && (w.b == (long) i) && (w.strings.back() == "record " + to_string(i));
+			count++;
+		}, error);
+		return ok && values_ok && count == 20;
+	};
+	{
+		st1::record_log_writer w(path, 100);
+		for (int i = 0; i < 250; i++) {
+			st1 v;
+			v.b = i;
+			v.strings.push_back("record " + to_string(i));
+			w.append(v);
+		}
+	}
+	if (!check(250, false)) return 1;
+	{
+		// a log which was not closed is opened from the last index in its header
+		using L = __as_record_log_layout;
+		ifstream in(path, ios::binary);
+		string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		in.close();
+		const uint64_t last = L::get<uint64_t>(data.data(), L::index_slots);
+		data.resize(last); // without the index written by `close`
+		memcpy(&data[L::index_slots], &data[L::index_slots + 8], 8);
+		memset(&data[L::index_slots + 8], 0, 8);
+		L layout;
+		if (!layout.parse(data.data(), data.size()) || layout.count() != 250 || layout.tail.size() != 50 || layout.truncated) return 1;
+		// the header can miss the newest indexes, which are found by following the records
+		memset(&data[L::index_slots], 0, 16);
+		if (!layout.parse(data.data(), data.size()) || layout.count() != 250 || layout.tail.size() != 50) return 1;
+	}
+	{
+		// reopening moves the last (partial) index after the new records
+		st1::record_log_writer w(path);
+		for (int i = 250; i < 260; i++) {
+			st1 v;
+			v.b = i;
+			v.strings.push_back("record " + to_string(i));
+			w.append(v);
+		}
+		if (w.size() != 260) return 1;
+	}
+	if (!check(260, false)) return 1;
+	{
+		// an index pointing to itself as the previous one is rejected, instead of being followed forever
+		using L = __as_record_log_layout;
+		ifstream in(path, ios::binary);
+		string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		const uint64_t middle = L::get<uint64_t>(data.data(), data.size() - L::index_trailer_size + 8);
+		memcpy(&data[L::index_end(data.data(), middle) - L::index_trailer_size + 8], &middle, 8);
+		ofstream("test_record_log_bad.tmp", ios::binary).write(data.data(), data.size());
+		st1::record_log_reader r;
+		const bool opened = r.open("test_record_log_bad.tmp");
+		remove("test_record_log_bad.tmp");
+		if (opened) return 1;
+	}
+	{
+		// simulate a crash while writing the last index
+		ifstream in(path, ios::binary);
+		string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		in.close();
+		ofstream out(path, ios::binary | ios::trunc);
+		out.write(data.data(), data.size() - 7);
+	}
+	if (!check(260, true)) return 1;
+	remove(path.c_str());
+	{
+		// a crash inside an index which completes the interval: its records are indexed when reopening
+		using L = __as_record_log_layout;
+		const string cut = "test_record_log_cut.tmp";
+		remove(cut.c_str());
+		auto append = [](st1::record_log_writer& w, int i) {
+			st1 v;
+			v.b = i;
+			w.append(v);
+		};
+		{
+			st1::record_log_writer w(cut, 2);
+			append(w, 0);
+			append(w, 1);
+		}
+		ifstream in(cut, ios::binary);
+		string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		in.close();
+		ofstream(cut, ios::binary | ios::trunc).write(data.data(), data.size() - L::index_min_size - 2 * 8 + 5);
+		{
+			st1::record_log_writer w(cut);
+			for (int i = 2; i < 5; i++) append(w, i);
+			if (w.size() != 5) return 1;
+		}
+		st1::record_log_reader r;
+		bool values_ok = r.open(cut) && r.size() == 5 && !r.truncated();
+		values_ok = values_ok && r.read_range(0, 5, [&](size_t i, st1& v) { values_ok = values_ok && v.b == (long) i; }, error);
+		remove(cut.c_str());
+		if (!values_ok) return 1;
+	}
+	cout << "record log: ok" << endl;
+	return 0;
+}
+
+// coroutine-based serializer test: drain a few bytes at a time, like a slow socket
+template<typename T>
+int test_async(const T& v, size_t capacity, size_t max_buffered = SIZE_MAX) {
+	stringstream expected;
+	v.serialize_to(expected);
+	typename T::async_serializer w(v, capacity);
+	string sent;
+	size_t max_pending = 0, resumes = 0;
+	while (!w.done()) {
+		w.resume();
+		resumes++;
+		max_pending = max(max_pending, w.pending().size());
+		size_t n = min<size_t>(w.pending().size(), 7);
+		sent += w.pending().substr(0, n);
+		w.consume(n);
+	}
+	sent += w.pending();
+	cout << "async: " << sent.size() << " bytes, " << resumes << " resumes, at most "
+		<< max_pending << " bytes buffered" << endl;
+	if (sent != expected.str()) {
+		cerr << "async output differs from serialize_to" << endl;
+		return 1;
+	}
+	return max_pending > max_buffered;
+}
+
+int test8() {
+	st2 t2;
+	t2.vec1.resize(50);
+	for (int i = 0; i < 50; i++) {
+		t2.vec1[i].b = i;
+		t2.vec1[i].ptr = new int(i);
+	}
+	st4 t4;
+	t4.base_ptr_a = new child4a(222, "new_data_a");
+	t4.base_ptr_b = new child4b(333, { 4, 8, 16, 22.5 });
+	t4.base_ptr_c = t4.base_ptr_a;
+	// long strings are written in pieces, without buffering them whole
+	st1 t1;
+	t1.strings.push_back(string(100000, 's'));
+	// consuming more than is pending only drops what is pending
+	__as_async_buffer b(16);
+	b.stream() << "abc";
+	b.consume(10);
+	b.stream() << "de";
+	if (b.pending() != "de") return 1;
+	return test_async(t2, 64) || test_async(t4, 16) || test_async(t1, 64, 256);
+}
+
+// canonical output and content hashes
+st7* make_st7(bool reversed) {
+	st7* v = new st7;
+	const vector<string> keys = { "alpha", "beta", "gamma", "delta", "epsilon", "zeta" };
+	for (size_t i = 0; i < keys.size(); i++) {
+		size_t j = reversed ? keys.size() - 1 - i : i;
+		v->counts[keys[j]] = j * 10;
+		v->ids.insert(j * 1000 + 7);
+	}
+	// allocate the pointed values in a different order
+	int* a = new int(11);
+	int* b = new int(22);
+	if (reversed) swap(*a, *b);
+	v->ptrs = reversed ? vector<int*>{ b, a, b } : vector<int*>{ a, b, a };
+	v->first = v->ptrs[1];
+	return v;
+}
+
+int test9() {
+	st7* x = make_st7(false);
+	st7* y = make_st7(true);
+	stringstream sx, sy;
+	x->serialize_to(sx, true);
+	y->serialize_to(sy, true);
+	if (sx.str() != sy.str()) {
+		cerr << "canonical outputs differ:" << endl << sy.str() << endl;
+		return 1;
+	}
+	if (!x->content_hash() || x->content_hash() != y->content_hash()) {
+		cerr << "content hashes differ" << endl;
+		return 1;
+	}
+	*y->first = 33;
+	if (x->content_hash() == y->content_hash()) {
+		cerr << "content hash didn't change" << endl;
+		return 1;
+	}
+	// the canonical output is read back like any other, and written again identically
+	st7 w;
+	bool ok = w.deserialize_from(sx, [&](const string& err) -> bool {
+		cerr << "deserialization error: " << err << endl;
+		return true;
+	});
+	stringstream sw;
+	w.serialize_to(sw, true);
+	if (!ok || sw.str() != sy.str() || w.content_hash() != x->content_hash()) {
+		cerr << "canonical copy differs:" << endl << sw.str() << endl;
+		return 1;
+	}
+	// pointer keys are ordered by the id of the pointed value, or by its content, not by address
+	auto make_st7b = [](bool reversed) {
+		st7b* b = new st7b;
+		b->values.resize(8);
+		vector<st7key*> keys(8);
+		for (int i = 0; i < 8; i++) {
+			const int j = reversed ? 7 - i : i;
+			b->values[j] = new int(j);
+			keys[j] = new st7key;
+			keys[j]->id = j;
+		}
+		b->known.insert(b->values.begin(), b->values.end());
+		b->fresh.insert(keys.begin(), keys.end());
+		b->sorted.insert(b->values.begin(), b->values.end());
+		for (int* v : b->values) {
+			b->weights[v] = *v * 2;
+			b->counts[v] = *v * 3;
+		}
+		return b;
+	};
+	st7b* p = make_st7b(false);
+	st7b* q = make_st7b(true);
+	stringstream sp, sq;
+	p->serialize_to(sp, true);
+	q->serialize_to(sq, true);
+	if (!sp || sp.str() != sq.str() || p->content_hash() != q->content_hash()) {
+		cerr << "canonical outputs with pointer keys differ:" << endl << sq.str() << endl;
+		return 1;
+	}
+	// keys without an order are written as usual, but not in canonical mode
+	st7key k;
+	k.id = 3;
+	p->keys.insert(k);
+	k.id = 4;
+	p->keys.insert(k);
+	stringstream plain, canonical;
+	p->serialize_to(plain);
+	p->serialize_to(canonical, true);
+	st7b r;
+	ok = r.deserialize_from(plain, [&](const string& err) -> bool {
+		cerr << "deserialization error: " << err << endl;
+		return true;
+	});
+	// pointer keys are filled once every value is read
+	bool keys_ok = r.sorted.size() == 8 && r.weights.size() == 8 && r.counts.size() == 8;
+	for (int* v : r.sorted) keys_ok = keys_ok && v && r.weights[v] == *v * 2 && r.counts[v] == *v * 3;
+	if (!ok || !keys_ok || !r.keys.count(k) || r.fresh.size() != 8 || !canonical.fail() || p->content_hash()) return 1;
+
+	// each key not written yet is hashed once, not at every comparison
+	st7d d;
+	vector<st7node*> nodes(500);
+	for (size_t i = 0; i < nodes.size(); i++) {
+		nodes[i] = new st7node();
+		nodes[i]->value = i;
+		if (i) nodes[i - 1]->next = nodes[i];
+	}
+	d.chain.insert(nodes.begin(), nodes.end());
+	stringstream chain;
+	d.serialize_to(chain, true);
+	if (!chain || !d.content_hash()) {
+		cerr << "canonical chain failed" << endl;
+		return 1;
+	}
+	// pointed values without an order, nor a content hash, can't be ordered
+	unordered_set<int> g1 = { 1 }, g2 = { 2 };
+	d.groups = { &g1 };
+	if (!d.content_hash()) return 1;
+	d.groups.insert(&g2);
+	return !!d.content_hash();
+}
+
+// columnar vectors
+int test10() {
+	st8 v;
+	int* shared_weight = new int(42);
+	for (int i = 0; i < 20; i++) {
+		st8point p;
+		p.id = i;
+		p.label = "point " + to_string(i);
+		p.x = i * 0.5;
+		p.y = -i;
+		p.visible = i % 3 == 0;
+		p.kind = i % 2 ? ST1_B : ST1_A;
+		p.weight = i % 4 ? shared_weight : nullptr;
+		p.tags.assign(i % 5, i);
+		v.points.push_back(p);
+	}
+	v.buffers.resize(2);
+	v.buffers[1].n_values = 2;
+	v.buffers[1].values = new double[2] { 1.25, -8 };
+	return test_it(v) || test_async(v, 32);
+}
+
+// parallel loading of many buffers and files
+int test11() {
+	const size_t n = 500;
+	vector<string> data(n);
+	vector<string_view> buffers(n);
+	for (size_t i = 0; i < n; i++) {
+		st1 v;
+		v.b = i;
+		v.strings = { "buffer", to_string(i) };
+		v.ptr = new int(i * 3);
+		stringstream ss;
+		v.serialize_to(ss);
+		data[i] = ss.str();
+		buffers[i] = data[i];
+	}
+	data[n / 2] = "st1 broken"; // reported, the other buffers are loaded anyway
+	buffers[n / 2] = data[n / 2];
+	vector<size_t> failed;
+	unique_ptr<st1[]> out(new st1[n]);
+	size_t loaded = st1::deserialize_many(buffers, out.get(), [&](size_t i, const string& err) {
+		failed.push_back(i); // calls are never concurrent
+		return true;
+	}, 8);
+	if (loaded != n - 1 || failed != vector<size_t>{ n / 2 }) {
+		cerr << "loaded " << loaded << " buffers" << endl;
+		return 1;
+	}
+	for (size_t i = 0; i < n; i++)
+		if (i != n / 2 && (out[i].b != (long) i || out[i].strings[1] != to_string(i) || *out[i].ptr != (int) i * 3)) {
+			cerr << "wrong value loaded at " << i << endl;
+			return 1;
+		}
+	// polymorphic types, from files
+	vector<string> paths;
+	for (int i = 0; i < 16; i++) {
+		st4 v;
+		v.base_ptr_a = new child4a(i, "file " + to_string(i));
+		v.base_ptr_b = new child4b(i, { 1.5, 2.5 });
+		v.base_ptr_c = new child4c(i, 0.25);
+		paths.push_back("test_many_" + to_string(i) + ".tmp");
+		ofstream f(paths.back(), ios::binary);
+		v.serialize_to(f);
+	}
+	paths.push_back("test_many_missing.tmp");
+	unique_ptr<st4[]> files(new st4[paths.size()]);
+	loaded = st4::deserialize_many(paths, files.get(), [](size_t, const string&) { return true; });
+	for (size_t i = 0; i < paths.size(); i++) remove(paths[i].c_str());
+	if (loaded != 16) {
+		cerr << "loaded " << loaded << " files" << endl;
+		return 1;
+	}
+	for (int i = 0; i < 16; i++) {
+		child4a* a = dynamic_cast<child4a*>(files[i].base_ptr_a);
+		if (!a || a->data_a != "file " + to_string(i) || !dynamic_cast<child4c*>(files[i].base_ptr_c)) {
+			cerr << "wrong file loaded at " << i << endl;
+			return 1;
+		}
+	}
+	// an exception thrown by one load, here by a huge vector length, stops the others and reaches the caller
+	const string count = "strings std::vector<std::string> 2 ";
+	const size_t at = data[n / 3].find(count);
+	if (at == string::npos) return 1;
+	data[n / 3].replace(at, count.size(), "strings std::vector<std::string> 4611686018427387903 ");
+	buffers[n / 3] = data[n / 3];
+	try {
+		st1::deserialize_many(buffers, out.get(), [](size_t, const string&) { return true; }, 8);
+	} catch (const exception& e) {
+		cout << "caught: " << e.what() << endl;
+		return 0;
+	}
+	cerr << "the exception was lost" << endl;
+	return 1;
+}
+
+// reused contexts: no allocations in the steady state, except for the values read
+template<typename T>
+bool steady_allocations(const T& v, T& w, st7::context& context, size_t expected_reads) {
+	stringstream ss;
+	const function<bool(string)> error = [](const string& err) {
+		cerr << "deserialization error: " << err << endl;
+		return true;
+	};
+	size_t writes = 0, sizes = 0, reads = 0;
+	for (int round = 0; round < 3; round++) {
+		size_t before = allocations;
+		ss.seekp(0);
+		v.serialize_to(ss, context);
+		writes = allocations - before;
+		before = allocations;
+		v.serialized_size(context);
+		sizes = allocations - before;
+		before = allocations;
+		ss.seekg(0);
+		if (!w.deserialize_from(ss, error, context)) return false;
+		reads = allocations - before;
+	}
+	cout << "allocations: " << writes << " writing, " << sizes << " sizing, " << reads << " reading" << endl;
+	return writes == 0 && sizes == 0 && reads == expected_reads;
+}
+
+int test12() {
+	st7* v = make_st7(false);
+	st7 w;
+	st7::context context;
+	// the two pointed values are allocated when reading
+	if (!steady_allocations(*v, w, context, 2)) return 1;
+	stringstream copy;
+	w.serialize_to(copy, context, true);
+	stringstream orig;
+	v->serialize_to(orig, true);
+	if (copy.str() != orig.str()) return 1;
+
+	// short strings, stored inline
+	st7c c, d;
+	auto a = make_shared<string>("a"), b = make_shared<string>("b");
+	c.shared = { a, a, b, nullptr };
+	c.hosts = { "host-a", "host-b", "host-a", "host-b" };
+	// each shared string and its owner, and each string of the `@dict` field once
+	if (!steady_allocations(c, d, context, 6)) return 1;
+	if (d.shared[0] != d.shared[1] || *d.shared[2] != "b" || d.shared[3] || d.hosts != c.hosts) return 1;
+
+	// the native columns are copied through the memory of the context
+	st8 p, q;
+	p.points.resize(100);
+	for (size_t i = 0; i < p.points.size(); i++) {
+		p.points[i].id = i;
+		p.points[i].x = i / 2.0;
+		p.points[i].visible = i % 3 == 0;
+	}
+	if (!steady_allocations(p, q, context, 0)) return 1;
+	return q.points.size() != 100 || q.points[99].id != 99 || q.points[99].x != 49.5 || !q.points[99].visible;
+}
+
+// lazy loading: nodes are read while walking the list, with the nodes they point to
+int test13() {
+	const int n = 1000;
+	st9 v;
+	vector<st9node*> nodes(n);
+	for (int i = 0; i < n; i++) {
+		nodes[i] = new st9node();
+		nodes[i]->value = i;
+		nodes[i]->name = "node " + to_string(i);
+	}
+	for (int i = 0; i < n; i++) {
+		nodes[i]->next = i + 1 < n ? nodes[i + 1] : nullptr;
+		nodes[i]->other = nodes[i / 2];
+	}
+	v.head = nodes[0];
+	v.count = new int(n);
+	v.total = n;
+	if (mode != 0) return test_it(v);
+	if (int r = test_it(v)) return r;
+	const string path = "test_lazy.tmp";
+	{
+		ofstream f(path, ios::binary);
+		f << "garbage before the output, offsets are relative ";
+		if (!v.serialize_indexed_to(f)) return 1;
+	}
+	string content;
+	{
+		ifstream f(path, ios::binary);
+		stringstream ss;
+		ss << f.rdbuf();
+		content = ss.str().substr(ss.str().find("st9 "));
+	}
+	remove(path.c_str());
+	const auto error = [](const string& err) {
+		cerr << "deserialization error: " << err << endl;
+		return true;
+	};
+	if (st9::lazy_source::from_memory("st9 0\n", [](const string&) { return true; })) return 1;
+	auto source = st9::lazy_source::from_memory(content, error);
+	st9 w;
+	if (!source || !source->read(w)) return 1;
+	if (w.total != n || source->loaded() != 0 || w.head.loaded()) return 1;
+	// the first node points to itself
+	if (w.head->value != 0 || w.head->other != w.head.get() || source->loaded() != 1) return 1;
+	st9node* node = w.head.get();
+	for (int i = 0; i < 10; i++) node = node->next.get();
+	// the nodes up to 10, and 5, 2, 1 through `other`
+	if (node->value != 10 || node->other->value != 5 || node->other->other->name != "node 2") return 1;
+	cout << "loaded " << source->loaded() << " of " << source->size() << " values" << endl;
+	if (source->loaded() != 11) return 1;
+	// writing loads the rest
+	stringstream orig, copy;
+	v.serialize_to(orig, true);
+	w.serialize_to(copy, true);
+	if (orig.str() != copy.str() || source->loaded() != source->size()) return 1;
+
+	// shared pointers loaded separately have a single owner
+	st9sproot sp;
+	sp.a = new st9spnode();
+	sp.b = new st9spnode();
+	sp.a->s = sp.b->s = make_shared<string>("shared");
+	stringstream indexed;
+	if (!sp.serialize_indexed_to(indexed)) return 1;
+	auto sp_source = st9sproot::lazy_source::from_memory(indexed.str(), error);
+	st9sproot sq;
+	if (!sp_source || !sp_source->read(sq)) return 1;
+	const shared_ptr<string> a = sq.a->s, b = sq.b->s;
+	if (a.get() != b.get() || *a != "shared" || a.owner_before(b) || b.owner_before(a)) return 1;
+
+	st9dictroot dr;
+	dr.tags = { "x", "y", "x" };
+	dr.a = new st9dictnode();
+	dr.a->tags = { "y", "z", "y" };
+	dr.b = new st9dictnode();
+	dr.b->tags = { "z", "x", "z" };
+	stringstream dict_indexed;
+	if (!dr.serialize_indexed_to(dict_indexed)) return 1;
+	auto dict_source = st9dictroot::lazy_source::from_memory(dict_indexed.str(), error);
+	st9dictroot ds;
+	if (!dict_source || !dict_source->read(ds)) return 1;
+	// the second value first
+	if (ds.b->tags != dr.b->tags || ds.a->tags != dr.a->tags || ds.tags != dr.tags) return 1;
+	st9dictroot full;
+	dict_indexed.seekg(0);
+	if (!full.deserialize_from(dict_indexed, error) || full.b->tags != dr.b->tags || full.tags != dr.tags) return 1;
+	// a value read with errors is not returned, even if the callback goes on
+	string broken = dict_indexed.str();
+	const size_t number = broken.find("=0", broken.find("\n2 "));
+	if (number == string::npos) return 1;
+	broken[number + 1] = '7';
+	size_t errors = 0;
+	auto broken_source = st9dictroot::lazy_source::from_memory(broken, [&](const string&) { errors++; return false; });
+	st9dictroot bs;
+	if (!broken_source || !broken_source->read(bs)) return 1;
+	return bs.a.get() == nullptr || bs.b.get() != nullptr || errors != 1;
+}
+
+// bit packing: flags and small integers in few hex digits
+int test14() {
+	st10 v;
+	v.visible = true;
+	v.kind = ST1_B;
+	v.level = -100;
+	v.delta = -16;
+	v.big = ~0ull;
+	v.name = "packed";
+	v.port = 65535;
+	v.nibbles = { 0, 15, 7, 8, 1 };
+	v.mask = { true, false, true, true };
+	for (int i = 0; i < 6; i++) v.grid[i] = 9 - i;
+	for (int i = 0; i < 5; i++) {
+		st10cell c;
+		c.alive = i % 2;
+		c.age = i * 50;
+		c.energy = i * 0.5;
+		v.cells.push_back(c);
+	}
+	if (mode != 0) return test_it(v);
+	if (int r = test_it(v)) return r;
+	stringstream ss;
+	v.serialize_to(ss);
+	string out = ss.str();
+	// values outside of the range are reported
+	const string port = "port bits<16> ";
+	size_t at = out.find(port);
+	if (at == string::npos || out.find("visible+selected+kind+level+delta+big bits<1,1,2,11,5,64> ") == string::npos) return 1;
+	out.replace(at + port.size(), 4, "ffff");
+	stringstream bad(out);
+	st10 w;
+	string error;
+	if (w.deserialize_from(bad, [&](const string& err) { error = err; return true; }) || error.find("port") == string::npos) return 1;
+	// and make the output fail when writing
+	v.level = 1001;
+	stringstream out_of_range;
+	v.serialize_to(out_of_range);
+	if (!out_of_range.fail()) return 1;
+	v.level = -100;
+	v.delta = 16; // doesn't fit in 5 signed bits
+	stringstream too_wide;
+	v.serialize_to(too_wide);
+	if (!too_wide.fail()) return 1;
+	v.delta = -16;
+	v.cells[1].age = -1;
+	stringstream column_out_of_range;
+	v.serialize_to(column_out_of_range);
+	if (!column_out_of_range.fail()) return 1;
+	v.cells[1].age = 50;
+	// long packed containers and columns are written in pieces
+	v.nibbles.assign(1000000, 7);
+	v.cells.resize(200000);
+	return test_async(v, 1024, 4096);
+}
+
+// dictionary encoding: repeated strings are written once
+int test15() {
+	const string names[] = { "alpha.example.com", "beta.example.com", "", "gamma.example.com" };
+	st11 v;
+	for (int i = 0; i < 200; i++) {
+		v.hosts.push_back(names[i % 4]);
+		v.plain.push_back(names[i % 4]);
+		v.shared.push_back(i % 5 ? make_shared<string>(names[i % 3]) : nullptr);
+	}
+	for (const string& n : names) v.counts[n] = n.size();
+	v.maybe = names[1];
+	if (mode != 0) return test_it(v);
+	if (int r = test_it(v)) return r;
+	stringstream ss;
+	v.serialize_to(ss);
+	const string out = ss.str();
+	const size_t hosts = out.find("\n", out.find("hosts ")) - out.find("hosts ");
+	const size_t plain = out.find("\n", out.find("plain ")) - out.find("plain ");
+	cout << "hosts: " << hosts << " bytes, plain: " << plain << " bytes" << endl;
+	if (hosts * 3 > plain) return 1;
+	st11 w;
+	if (!w.deserialize_from(ss, [](const string&) { return true; })) return 1;
+	// equal shared strings share their value
+	if (w.shared[1].get() != w.shared[4].get() || *w.shared[1] != names[1] || w.shared[0] || w.hosts != v.hosts) return 1;
+	// numbers out of the table are reported
+	stringstream bad(string(out).replace(out.find("=", out.find("hosts ")), 2, "=9"));
+	return w.deserialize_from(bad, [](const string&) { return true; });
+}
+
+// framed output: every block is checked before reading anything
+int test16() {
+	// the accelerated crc matches the known value and the software one, also when continued
+	if (__as_crc32c("123456789", 9) != 0xe3069283) return 1;
+	string noise(1000, '\0');
+	for (size_t i = 0; i < noise.size(); i++) noise[i] = (char) (i * 131 + 7);
+	for (size_t n : { 0, 1, 7, 8, 9, 63, 999 })
+		if (__as_crc32c(&noise[1], n) != ~__as_crc32c_sw(~0u, &noise[1], n)
+				|| __as_crc32c(&noise[1], n) != __as_crc32c(&noise[1 + n / 3], n - n / 3, __as_crc32c(&noise[1], n / 3)))
+			return 1;
+	st4 v;
+	v.base_ptr_a = new child4a(222, "framed_a");
+	v.base_ptr_b = new child4b(333, { 4, 8, 16, 22.5 });
+	v.base_ptr_c = new child4c(444, 71.923);
+	if (mode != 0) return test_it(v);
+	// small blocks, so that polymorphic types are peeked across blocks
+	stringstream ss;
+	v.serialize_framed_to(ss, 16);
+	const string framed = ss.str();
+	string error;
+	const auto on_error = [&](const string& err) { error = err; return true; };
+	st4 w;
+	if (!w.deserialize_framed_from(framed, on_error, 4)) return 1;
+	stringstream orig, copy;
+	v.serialize_to(orig, true);
+	w.serialize_to(copy, true);
+	if (orig.str() != copy.str()) return 1;
+	// a flipped bit in the sixth block (after the 8 bytes of magic, blocks take 8 + 16 bytes)
+	string corrupt = framed;
+	corrupt[8 + 5 * 24 + 8 + 3] ^= 4;
+	st4 x;
+	x.base_ptr_a = nullptr; // stays untouched
+	if (x.deserialize_framed_from(corrupt, on_error, 4) || error != "framed input: corrupt block at offset 128" || x.base_ptr_a) return 1;
+	// the empty block at the end is missing
+	if (x.deserialize_framed_from(string_view(framed).substr(0, framed.size() - 8), on_error) || error.find("truncated") == string::npos) return 1;
+	return 0;
+}
+
+// structs with only native fields: objects and vectors of them are written as raw memory
+int test17() {
+	static_assert(st12point::_is_raw() && st12cell::_is_raw() && !st12padded::_is_raw());
+	st12 v;
+	for (int i = 0; i < 1000; i++) {
+		v.points.push_back({ i * 0.5f, -i * 0.25f, 1e6f / (i + 1), i });
+		st12cell c;
+		for (int j = 0; j < 3; j++) c.rgb[j] = i + j;
+		c.corners[0][0] = -i; c.corners[0][1] = i; c.corners[1][0] = 2 * i; c.corners[1][1] = 7;
+		v.cells.push_back(c);
+	}
+	v.padded.push_back({ 'x', 0.125 });
+	v.padded.push_back({ 'y', -3 });
+	v.origin = { 1, 2, 3, 4 };
+	if (mode != 0) return test_it(v);
+	if (test_it(v) || test_async(v, 64, 256)) return 1;
+	stringstream ss;
+	v.serialize_to(ss);
+	const string out = ss.str();
+	cout << "raw: " << out.size() << " bytes" << endl;
+	if (out.size() > 1000 * (sizeof(st12point) + sizeof(st12cell)) + 500 || out.find("st12padded 2") == string::npos) return 1;
+	st12 w;
+	if (!w.deserialize_from(ss, [](const string&) { return true; })) return 1;
+	if (w.points.size() != 1000 || w.points[999].id != 999 || w.points[10].z != v.points[10].z
+			|| w.cells[5].corners[1][0] != 10 || w.padded[1].tag != 'y' || w.origin.id != 4 || !w.empty.empty())
+		return 1;
+	// a different layout is reported
+	string error;
+	const size_t at = out.find("#raw ") + 5;
+	stringstream bad(string(out).replace(at, 1, out[at] == '0' ? "1" : "0"));
+	return w.deserialize_from(bad, [&](const string& err) { error = err; return true; }) || error.find("expected type") == string::npos;
+}
+
+// @sparse fields are written only when they differ from their initializer
+int test18() {
+	st13 v;
+	v.name = "sparse";
+	if (mode != 0) return test_it(v);
+	if (test_it(v)) return 1;
+	stringstream defaults;
+	v.serialize_to(defaults);
+	cout << "defaults: " << defaults.str().size() << " bytes" << endl;
+	if (defaults.str().rfind("st13 1\n", 0) != 0 || defaults.str().find("retries") != string::npos) return 1;
+	v.retries = 5;
+	v.ports.clear();
+	v.verbose = false;
+	if (test_it(v) || test_async(v, 16)) return 1;
+	stringstream changed;
+	v.serialize_to(changed);
+	if (changed.str().rfind("st13 4\n", 0) != 0 || changed.str().find("host") != string::npos) return 1;
+	// omitted fields are reset to their default
+	st13 w;
+	if (!w.deserialize_from(changed, [](const string&) { return true; })) return 1;
+	if (w.retries != 5 || !w.ports.empty() || w.verbose != false || w.host != "localhost") return 1;
+	w.host = "example.com";
+	w.limits.clear();
+	if (!w.deserialize_from(defaults, [](const string&) { return true; })) return 1;
+	if (w.retries != 3 || w.ports.size() != 2 || w.verbose || w.host != "localhost" || w.limits.at("cpu") != 4) return 1;
+	v.level = 50;
+	v.debug = true;
+	v.nibbles = { 15 };
+	if (test_it(v)) return 1;
+	stringstream packed;
+	v.serialize_to(packed);
+	if (packed.str().rfind("st13 7\n", 0) != 0) return 1;
+	if (!w.deserialize_from(packed, [](const string&) { return true; }) || w.level != 50 || !w.debug || w.nibbles != v.nibbles) return 1;
+	defaults.clear();
+	defaults.seekg(0);
+	if (!w.deserialize_from(defaults, [](const string&) { return true; })) return 1;
+	return w.level != 7 || w.debug || w.nibbles.size() != 2;
+}
+
+// the memory owned by an object graph: inline size, buffers, and each pointed value once
+int test19() {
+	st14 v;
+	if (v.memory_footprint() != sizeof(st14)) return 1;
+	v.big.assign(1000, 'x');
+	v.values.reserve(100);
+	v.names[1] = "one";
+	v.owned.reset(new vector<double>(50));
+	v.shared_a = v.shared_b = make_shared<string>(2000, 'y');
+	st14node a{ "a" }, b{ string(100, 'b'), &a };
+	a.next = &b;
+	v.ring = &a;
+	v.nodes.resize(2);
+	v.nodes[1].label.assign(300, 'n');
+	if (mode != 0) return test_it(v);
+	if (test_it(v)) return 1;
+	const size_t expected = sizeof(st14) + v.big.capacity() + 1 + v.values.capacity() * sizeof(int32_t)
+		+ __as_node_heap(v.names, 3) + sizeof(vector<double>) + v.owned->capacity() * sizeof(double)
+		+ __as_shared_block + sizeof(string) + v.shared_a->capacity() + 1
+		+ 2 * sizeof(st14node) + b.label.capacity() + 1
+		+ v.nodes.capacity() * sizeof(st14node) + v.nodes[1].label.capacity() + 1;
+	vector<pair<string, size_t>> fields;
+	const size_t total = v.memory_footprint(fields);
+	cout << "footprint: " << total << " bytes" << endl;
+	if (total != expected || v.memory_footprint() != total || fields.size() != 9) return 1;
+	for (const auto& f : fields) cout << "\t" << f.first << ": " << f.second << endl;
+	// long chains are counted without recursion
+	vector<st14node> chain(500000);
+	for (size_t i = 0; i + 1 < chain.size(); i++) chain[i].next = &chain[i + 1];
+	if (chain[0].memory_footprint() != chain.size() * sizeof(st14node)) return 1;
+	// the pointed value is counted by the first field pointing to it
+	return fields[0].first != "small" || fields[0].second != sizeof(string) || fields[1].second != sizeof(string) + v.big.capacity() + 1
+		|| fields[5].second <= 2000 || fields[6].second != sizeof(v.shared_b) || fields[7].second != sizeof(st14node*) + 2 * sizeof(st14node) + b.label.capacity() + 1;
+}
+
 #define _TEST(n) \
 	cerr << "--- TEST " << #n << " ---" << endl << endl; \
 	return test##n();
@@ -136,5 +995,28 @@ int main(int argc, char** argv) {
 		// output mode
 		if (argv[1][0] == 'o') mode = 2;
 	}
-	_TEST(1);
+	// the second argument selects the test
+	switch (argc > 2 ? atoi(argv[2]) : 1) {
+		case 1: _TEST(1);
+		case 2: _TEST(2);
+		case 3: _TEST(3);
+		case 4: _TEST(4);
+		case 5: _TEST(5);
+		case 6: _TEST(6);
+		case 7: _TEST(7);
+		case 8: _TEST(8);
+		case 9: _TEST(9);
+		case 10: _TEST(10);
+		case 11: _TEST(11);
+		case 12: _TEST(12);
+		case 13: _TEST(13);
+		case 14: _TEST(14);
+		case 15: _TEST(15);
+		case 16: _TEST(16);
+		case 17: _TEST(17);
+		case 18: _TEST(18);
+		case 19: _TEST(19);
+	}
+	cerr << "unknown test" << endl;
+	return 1;
 }